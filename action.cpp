@@ -84,6 +84,67 @@ std::string Action::toString() const {
   return ss.str();
 }
 
+namespace {
+
+// Bit layout of a packed action.
+constexpr int kPlayerColorShift = 0;
+constexpr int kActionTypeShift = 2;
+constexpr int kCardShift = 5;
+constexpr int kPiece1IndexShift = 9;
+constexpr int kMove1DestinationShift = 11;
+constexpr int kPiece2IndexShift = 18;
+constexpr int kMove2DestinationShift = 20;
+
+constexpr uint32_t kPlayerColorMask = 0x3;
+constexpr uint32_t kActionTypeMask = 0x7;
+constexpr uint32_t kCardMask = 0xF;
+constexpr uint32_t kPieceIndexMask = 0x3;
+constexpr uint32_t kDestinationMask = 0x7F;
+
+} // namespace
+
+uint32_t Action::pack() const {
+  uint32_t packed = (static_cast<uint32_t>(playerColor) << kPlayerColorShift) |
+                    (static_cast<uint32_t>(actionType) << kActionTypeShift);
+  // Fields which are not used by this type of action are left uninitialized by the factories, so only pack the ones which are.
+  if (actionType != ActionType::kSorry && actionType != ActionType::kSwap) {
+    packed |= static_cast<uint32_t>(card) << kCardShift;
+  }
+  if (actionType == ActionType::kSingleMove || actionType == ActionType::kDoubleMove || actionType == ActionType::kSwap) {
+    packed |= static_cast<uint32_t>(piece1Index) << kPiece1IndexShift;
+  }
+  if (actionType != ActionType::kDiscard) {
+    packed |= static_cast<uint32_t>(move1Destination) << kMove1DestinationShift;
+  }
+  if (actionType == ActionType::kDoubleMove) {
+    packed |= (static_cast<uint32_t>(piece2Index) << kPiece2IndexShift) |
+              (static_cast<uint32_t>(move2Destination) << kMove2DestinationShift);
+  }
+  return packed;
+}
+
+Action Action::unpack(uint32_t packed) {
+  const PlayerColor playerColor = static_cast<PlayerColor>((packed >> kPlayerColorShift) & kPlayerColorMask);
+  const ActionType actionType = static_cast<ActionType>((packed >> kActionTypeShift) & kActionTypeMask);
+  const Card card = static_cast<Card>((packed >> kCardShift) & kCardMask);
+  const int piece1Index = (packed >> kPiece1IndexShift) & kPieceIndexMask;
+  const int move1Destination = (packed >> kMove1DestinationShift) & kDestinationMask;
+  const int piece2Index = (packed >> kPiece2IndexShift) & kPieceIndexMask;
+  const int move2Destination = (packed >> kMove2DestinationShift) & kDestinationMask;
+  if (actionType == ActionType::kDiscard) {
+    return discard(playerColor, card);
+  } else if (actionType == ActionType::kSingleMove) {
+    return singleMove(playerColor, card, piece1Index, move1Destination);
+  } else if (actionType == ActionType::kDoubleMove) {
+    return doubleMove(playerColor, card, piece1Index, move1Destination, piece2Index, move2Destination);
+  } else if (actionType == ActionType::kSorry) {
+    return sorry(playerColor, move1Destination);
+  } else if (actionType == ActionType::kSwap) {
+    return swap(playerColor, piece1Index, move1Destination);
+  }
+  throw std::runtime_error("Unknown packed action type");
+}
+
 bool operator==(const Action &lhs, const Action &rhs) {
   if (lhs.playerColor != rhs.playerColor) {
     return false;
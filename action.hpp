@@ -24,6 +24,11 @@ public:
   static Action swap(PlayerColor playerColor, int pieceIndex, int moveDestination);
   std::string toString() const;
 
+  // Packs the fields which are meaningful for this action's type into the low 27 bits. Two actions are equal if and only if their packed forms are.
+  uint32_t pack() const;
+  // The inverse of `pack`. Throws std::runtime_error if the action type bits hold 5-7, which `pack` never produces; the other fields are not checked.
+  static Action unpack(uint32_t packed);
+
   PlayerColor playerColor;
   ActionType actionType;
   Card card;
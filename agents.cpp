@@ -0,0 +1,181 @@
+#include "agents.hpp"
+#include "common.hpp"
+#include "sorry.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+RandomAgent::RandomAgent() : eng_(createRandomEngine()) {}
+
+sorry::Action RandomAgent::getAction(const sorry::Sorry &state) {
+  const auto actions = state.getActions();
+  uniform_int_distribution<> dist(0, actions.size()-1);
+  return actions.at(dist(eng_));
+}
+
+IterationBoundMctsAgent::IterationBoundMctsAgent(double explorationConstant, int maxIterationCount, int searchThreadCount, ThreadPool *pool, const RaceTablebase *raceTablebase) : mcts_(explorationConstant), maxIterationCount_(maxIterationCount) {
+  mcts_.setThreadCount(searchThreadCount);
+  mcts_.setThreadPool(pool);
+  mcts_.setRaceTablebase(raceTablebase);
+}
+
+sorry::Action IterationBoundMctsAgent::getAction(const sorry::Sorry &state) {
+  mcts_.run(state, maxIterationCount_);
+  const sorry::Action action = mcts_.pickBestAction();
+  mcts_.reset();
+  return action;
+}
+
+std::optional<SearchStats> IterationBoundMctsAgent::lastSearchStats() const {
+  return mcts_.getSearchStats();
+}
+
+TimeBoundMctsAgent::TimeBoundMctsAgent(double explorationConstant, std::chrono::duration<double> timePerMove, int searchThreadCount, ThreadPool *pool, const RaceTablebase *raceTablebase) : mcts_(explorationConstant), timePerMove_(timePerMove) {
+  mcts_.setThreadCount(searchThreadCount);
+  mcts_.setThreadPool(pool);
+  mcts_.setRaceTablebase(raceTablebase);
+}
+
+sorry::Action TimeBoundMctsAgent::getAction(const sorry::Sorry &state) {
+  mcts_.run(state, timePerMove_);
+  const sorry::Action action = mcts_.pickBestAction();
+  mcts_.reset();
+  return action;
+}
+
+std::optional<SearchStats> TimeBoundMctsAgent::lastSearchStats() const {
+  return mcts_.getSearchStats();
+}
+
+MultiplexedMctsAgent::MultiplexedMctsAgent(double explorationConstant, std::chrono::duration<double> timePerMove, SearchMultiplexer &multiplexer, const RaceTablebase *raceTablebase) : mcts_(explorationConstant), timePerMove_(timePerMove), multiplexer_(multiplexer) {
+  mcts_.setRaceTablebase(raceTablebase);
+}
+
+sorry::Action MultiplexedMctsAgent::getAction(const sorry::Sorry &state) {
+  const auto deadline = SearchMultiplexer::Clock::now() + std::chrono::duration_cast<SearchMultiplexer::Clock::duration>(timePerMove_);
+  MultiplexedSearchResult result = multiplexer_.submit(mcts_, state, deadline).get();
+  mcts_.reset();
+  // The search's own stats only cover its last slice.
+  lastSearchStats_ = result.stats;
+  return result.bestAction;
+}
+
+std::optional<SearchStats> MultiplexedMctsAgent::lastSearchStats() const {
+  return lastSearchStats_;
+}
+
+GameClockMctsAgent::GameClockMctsAgent(double explorationConstant, std::chrono::duration<double> gameTime, int searchThreadCount, ThreadPool *pool, const RaceTablebase *raceTablebase) : mcts_(explorationConstant), clock_(gameTime) {
+  mcts_.setThreadCount(searchThreadCount);
+  mcts_.setThreadPool(pool);
+  mcts_.setRaceTablebase(raceTablebase);
+  mcts_.setEarlyStopping(true);
+}
+
+sorry::Action GameClockMctsAgent::getAction(const sorry::Sorry &state) {
+  const auto startTime = std::chrono::steady_clock::now();
+  mcts_.run(state, clock_.budgetFor(state));
+  const sorry::Action action = mcts_.pickBestAction();
+  mcts_.reset();
+  clock_.spend(std::chrono::steady_clock::now() - startTime);
+  return action;
+}
+
+std::optional<SearchStats> GameClockMctsAgent::lastSearchStats() const {
+  return mcts_.getSearchStats();
+}
+
+ExpectimaxAgent::ExpectimaxAgent(int maxDepth, std::optional<std::chrono::duration<double>> timePerMove) : maxDepth_(maxDepth), timePerMove_(timePerMove) {}
+
+sorry::Action ExpectimaxAgent::getAction(const sorry::Sorry &state) {
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  if (timePerMove_) {
+    deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(*timePerMove_);
+  }
+  return search_.search(state, maxDepth_, deadline).bestAction;
+}
+
+sorry::Action HumanAgent::getAction(const sorry::Sorry &state) {
+  cout << "State: " << state.toString() << endl;
+  const auto actions = state.getActions();
+  for (size_t i=0; i<actions.size(); ++i) {
+    cout << "  " << i << ": " << actions.at(i).toString() << endl;
+  }
+  int choice = -1;
+  while (choice < 0 || choice >= static_cast<int>(actions.size())) {
+    cout << "Please choose [0-" << actions.size()-1 << "]: ";
+    cin >> choice;
+  }
+  return actions.at(choice);
+}
+
+PendingDecision::PendingDecision(std::future<sorry::Action> action, std::shared_ptr<DeadlineCondition> condition, std::shared_ptr<std::atomic<bool>> cancelled) : action_(std::move(action)), condition_(std::move(condition)), cancelled_(std::move(cancelled)) {}
+
+bool PendingDecision::ready() const {
+  return action_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+sorry::Action PendingDecision::get() {
+  return action_.get();
+}
+
+void PendingDecision::setDeadline(std::chrono::steady_clock::time_point deadline) {
+  condition_->setDeadline(deadline);
+}
+
+void PendingDecision::moveNow() {
+  condition_->stop();
+}
+
+void PendingDecision::cancel() {
+  *cancelled_ = true;
+  condition_->stop();
+}
+
+AsyncAgentAdapter::AsyncAgentAdapter(std::unique_ptr<BaseAgent> agent) : agent_(std::move(agent)) {}
+
+PendingDecision AsyncAgentAdapter::decide(const sorry::Sorry &state, std::chrono::steady_clock::time_point deadline) {
+  auto condition = std::make_shared<DeadlineCondition>(deadline);
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  auto action = worker_.submit([this, state, cancelled]() {
+    if (*cancelled) {
+      throw std::runtime_error("Decision cancelled");
+    }
+    const sorry::Action action = agent_->getAction(state);
+    if (*cancelled) {
+      throw std::runtime_error("Decision cancelled");
+    }
+    return action;
+  });
+  return PendingDecision(std::move(action), std::move(condition), std::move(cancelled));
+}
+
+AsyncMctsAgent::AsyncMctsAgent(double explorationConstant, bool ponder) : mcts_(explorationConstant), ponder_(ponder) {}
+
+PendingDecision AsyncMctsAgent::decide(const sorry::Sorry &state, std::chrono::steady_clock::time_point deadline) {
+  auto condition = std::make_shared<DeadlineCondition>(deadline);
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  auto action = worker_.submit([this, state, condition, cancelled]() {
+    if (*cancelled) {
+      throw std::runtime_error("Decision cancelled");
+    }
+    // Stops any pondering and continues from whatever part of its tree is still relevant.
+    mcts_.run(state, condition.get());
+    if (*cancelled) {
+      throw std::runtime_error("Decision cancelled");
+    }
+    return mcts_.pickBestAction();
+  });
+  return PendingDecision(std::move(action), std::move(condition), std::move(cancelled));
+}
+
+void AsyncMctsAgent::opponentsToMove(const sorry::Sorry &state, sorry::PlayerColor ourPlayer) {
+  if (!ponder_) {
+    return;
+  }
+  // On the worker, so that it is ordered with the searches.
+  worker_.submit([this, state, ourPlayer]() {
+    mcts_.startPondering(state, ourPlayer);
+  });
+}
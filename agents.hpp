@@ -0,0 +1,155 @@
+#ifndef AGENTS_HPP_
+#define AGENTS_HPP_
+
+#include "action.hpp"
+#include "expectimaxSearch.hpp"
+#include "playerColor.hpp"
+#include "searchMultiplexer.hpp"
+#include "sorryMcts.hpp"
+#include "threadPool.hpp"
+#include "timeManager.hpp"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <random>
+
+namespace sorry {
+class Sorry;
+} // namespace sorry
+
+class BaseAgent {
+public:
+  virtual ~BaseAgent() = default;
+  virtual sorry::Action getAction(const sorry::Sorry &state) = 0;
+  // What the search behind the latest `getAction` did, for agents which search with SorryMcts.
+  virtual std::optional<SearchStats> lastSearchStats() const { return std::nullopt; }
+};
+
+class RandomAgent : public BaseAgent {
+public:
+  RandomAgent();
+  sorry::Action getAction(const sorry::Sorry &state) override;
+private:
+  std::mt19937 eng_;
+};
+
+// The MCTS agents search on `searchThreadCount` threads, which run on `pool` if given. See SorryMcts::setThreadPool. They look up two-player races in `raceTablebase` if given, which must outlive them; see SorryMcts::setRaceTablebase.
+class IterationBoundMctsAgent : public BaseAgent {
+public:
+  IterationBoundMctsAgent(double explorationConstant, int maxIterationCount, int searchThreadCount = 1, ThreadPool *pool = nullptr, const RaceTablebase *raceTablebase = nullptr);
+  sorry::Action getAction(const sorry::Sorry &state) override;
+  std::optional<SearchStats> lastSearchStats() const override;
+private:
+  SorryMcts mcts_;
+  int maxIterationCount_;
+};
+
+// Searches for a fixed amount of wall-clock time per move.
+class TimeBoundMctsAgent : public BaseAgent {
+public:
+  TimeBoundMctsAgent(double explorationConstant, std::chrono::duration<double> timePerMove, int searchThreadCount = 1, ThreadPool *pool = nullptr, const RaceTablebase *raceTablebase = nullptr);
+  sorry::Action getAction(const sorry::Sorry &state) override;
+  std::optional<SearchStats> lastSearchStats() const override;
+private:
+  SorryMcts mcts_;
+  std::chrono::duration<double> timePerMove_;
+};
+
+// Searches for a fixed amount of wall-clock time per move, on the threads of `multiplexer`, which it shares with the agents of other games. The multiplexer must outlive the agent.
+class MultiplexedMctsAgent : public BaseAgent {
+public:
+  MultiplexedMctsAgent(double explorationConstant, std::chrono::duration<double> timePerMove, SearchMultiplexer &multiplexer, const RaceTablebase *raceTablebase = nullptr);
+  sorry::Action getAction(const sorry::Sorry &state) override;
+  std::optional<SearchStats> lastSearchStats() const override;
+private:
+  SorryMcts mcts_;
+  std::chrono::duration<double> timePerMove_;
+  SearchMultiplexer &multiplexer_;
+  std::optional<SearchStats> lastSearchStats_;
+};
+
+// Has `gameTime` for all of its moves in a game, split up by a TimeManager. Searches stop early once more time couldn't change the pick, leaving the time for later moves.
+class GameClockMctsAgent : public BaseAgent {
+public:
+  GameClockMctsAgent(double explorationConstant, std::chrono::duration<double> gameTime, int searchThreadCount = 1, ThreadPool *pool = nullptr, const RaceTablebase *raceTablebase = nullptr);
+  sorry::Action getAction(const sorry::Sorry &state) override;
+  std::optional<SearchStats> lastSearchStats() const override;
+private:
+  SorryMcts mcts_;
+  TimeManager clock_;
+};
+
+// Picks its action with an ExpectimaxSearch, deepening until `maxDepth` plies or, if given, until `timePerMove` runs out.
+class ExpectimaxAgent : public BaseAgent {
+public:
+  ExpectimaxAgent(int maxDepth, std::optional<std::chrono::duration<double>> timePerMove);
+  sorry::Action getAction(const sorry::Sorry &state) override;
+private:
+  ExpectimaxSearch search_;
+  int maxDepth_;
+  std::optional<std::chrono::duration<double>> timePerMove_;
+};
+
+class HumanAgent : public BaseAgent {
+public:
+  HumanAgent() = default;
+  sorry::Action getAction(const sorry::Sorry &state) override;
+};
+
+// A decision which an AsyncAgent is still working on.
+class PendingDecision {
+public:
+  PendingDecision(std::future<sorry::Action> action, std::shared_ptr<DeadlineCondition> condition, std::shared_ptr<std::atomic<bool>> cancelled);
+  bool ready() const;
+  // Blocks until the action is decided. Throws if the decision was cancelled.
+  sorry::Action get();
+  // Decide by `deadline` instead. Agents which can't be interrupted ignore this.
+  void setDeadline(std::chrono::steady_clock::time_point deadline);
+  // Decide with what has been worked out so far.
+  void moveNow();
+  // Stop working on the decision; `get` will throw.
+  void cancel();
+private:
+  std::future<sorry::Action> action_;
+  std::shared_ptr<DeadlineCondition> condition_;
+  std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// An agent which decides in the background, so that one thread can drive many of them, and overlap their searches with each other and with I/O.
+//
+// Each agent works on one thing at a time, in the order asked. Destroying it waits for what it was asked to do.
+class AsyncAgent {
+public:
+  virtual ~AsyncAgent() = default;
+  // Starts deciding the move in `state`, which is copied.
+  virtual PendingDecision decide(const sorry::Sorry &state, std::chrono::steady_clock::time_point deadline) = 0;
+  // Tells the agent that `state` is the position right after its own action, so that it can think while the opponents move. Optional.
+  virtual void opponentsToMove(const sorry::Sorry &state, sorry::PlayerColor ourPlayer) {}
+};
+
+// Runs a synchronous agent's `getAction` in the background. It can't be interrupted, so deadlines and moving now have no effect.
+class AsyncAgentAdapter : public AsyncAgent {
+public:
+  explicit AsyncAgentAdapter(std::unique_ptr<BaseAgent> agent);
+  PendingDecision decide(const sorry::Sorry &state, std::chrono::steady_clock::time_point deadline) override;
+private:
+  std::unique_ptr<BaseAgent> agent_;
+  // Declared last so that it finishes its work before the agent is destroyed.
+  ThreadPool worker_{1};
+};
+
+// Searches until the deadline, and optionally ponders while the opponents move. Keeps its tree from one decision to the next.
+class AsyncMctsAgent : public AsyncAgent {
+public:
+  AsyncMctsAgent(double explorationConstant, bool ponder);
+  PendingDecision decide(const sorry::Sorry &state, std::chrono::steady_clock::time_point deadline) override;
+  void opponentsToMove(const sorry::Sorry &state, sorry::PlayerColor ourPlayer) override;
+private:
+  SorryMcts mcts_;
+  const bool ponder_;
+  ThreadPool worker_{1};
+};
+
+#endif // AGENTS_HPP_
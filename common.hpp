@@ -1,8 +1,18 @@
 #ifndef COMMON_HPP_
 #define COMMON_HPP_
 
+#include <cstdint>
 #include <random>
 
 std::mt19937 createRandomEngine();
 
+// Mixes `value` into `seed`. Used to build 64-bit position keys.
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+  // splitmix64 finalizer.
+  uint64_t x = seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
 #endif // COMMON_HPP_
\ No newline at end of file
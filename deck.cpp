@@ -1,3 +1,4 @@
+#include "common.hpp"
 #include "deck.hpp"
 
 #include <algorithm>
@@ -26,8 +27,9 @@ void Deck::initialize() {
 }
 
 void Deck::removeSpecificCard(Card card) {
-  auto it = std::find(cards_.begin(), cards_.begin()+firstOutIndex_, card);
-  if (it == cards_.end()) {
+  const auto faceDownEnd = cards_.begin()+firstOutIndex_;
+  auto it = std::find(cards_.begin(), faceDownEnd, card);
+  if (it == faceDownEnd) {
     throw std::runtime_error("Card not found in deck");
   }
   removeCard(std::distance(cards_.begin(), it));
@@ -55,10 +57,43 @@ void Deck::discard(Card card) {
   throw std::runtime_error("Cannot discard card which is not in \"out\" section");
 }
 
+void Deck::returnCard(Card card) {
+  // Look for the card in the "out" range
+  for (size_t i=firstOutIndex_; i<firstDiscardIndex_; ++i) {
+    if (cards_[i] == card) {
+      // Found our card, move it to the end of the face-down range.
+      std::swap(cards_[i], cards_[firstOutIndex_]);
+      ++firstOutIndex_;
+      return;
+    }
+  }
+  print();
+  throw std::runtime_error("Cannot return card which is not in \"out\" section");
+}
+
+void Deck::sortFaceDown() {
+  std::sort(cards_.begin(), cards_.begin()+firstOutIndex_);
+}
+
 size_t Deck::size() const {
   return firstOutIndex_;
 }
 
+std::vector<std::pair<Card, int>> Deck::faceDownCardCounts() const {
+  // Card values are all below 13.
+  std::array<int, 13> counts{};
+  for (size_t i=0; i<firstOutIndex_; ++i) {
+    ++counts[static_cast<int>(cards_[i])];
+  }
+  std::vector<std::pair<Card, int>> result;
+  for (size_t value=0; value<counts.size(); ++value) {
+    if (counts[value] > 0) {
+      result.emplace_back(static_cast<Card>(value), counts[value]);
+    }
+  }
+  return result;
+}
+
 bool Deck::empty() const {
   return firstOutIndex_ == 0;
 }
@@ -86,6 +121,27 @@ void Deck::shuffle() {
   }
 }
 
+uint64_t Deck::hash() const {
+  // Cards are always drawn uniformly at random, so only the count of each card matters. There are at most 5 of any card, so each count fits in 3 bits.
+  uint64_t faceDownCounts = 0;
+  uint64_t discardCounts = 0;
+  for (size_t i=0; i<firstOutIndex_; ++i) {
+    faceDownCounts += 1ull << (3*static_cast<int>(cards_[i]));
+  }
+  for (size_t i=firstDiscardIndex_; i<cards_.size(); ++i) {
+    discardCounts += 1ull << (3*static_cast<int>(cards_[i]));
+  }
+  return hashCombine(faceDownCounts, discardCounts);
+}
+
+uint64_t Deck::publicHash() const {
+  uint64_t discardCounts = 0;
+  for (size_t i=firstDiscardIndex_; i<cards_.size(); ++i) {
+    discardCounts += 1ull << (3*static_cast<int>(cards_[i]));
+  }
+  return hashCombine(firstOutIndex_, discardCounts);
+}
+
 bool operator==(const sorry::Deck &lhs, const sorry::Deck &rhs) {
   if (lhs.firstOutIndex_ != rhs.firstOutIndex_) {
     return false;
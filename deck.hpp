@@ -5,6 +5,8 @@
 
 #include <array>
 #include <random>
+#include <utility>
+#include <vector>
 
 namespace sorry {
 
@@ -15,9 +17,19 @@ public:
   void removeSpecificCard(Card card);
   Card drawRandomCard(std::mt19937 &eng);
   void discard(Card card);
+  // Puts a card which is out (in someone's hand) back into the face-down deck.
+  void returnCard(Card card);
+  // Orders the face-down cards by value, so that which cards random draws pick depends only on the engine and on which cards are face down, not on how they got there.
+  void sortFaceDown();
   size_t size() const;
+  // Count of each card which is face down, in order of card value, leaving out cards with none.
+  std::vector<std::pair<Card, int>> faceDownCardCounts() const;
   bool empty() const;
   void shuffle();
+  // Depends only on which cards are face-down and which are discarded, not on their order.
+  uint64_t hash() const;
+  // Like `hash`, but only depends on what every player can see: the discard pile and the size of the face-down deck.
+  uint64_t publicHash() const;
 private:
   std::array<Card, 45> cards_;
   size_t firstOutIndex_;
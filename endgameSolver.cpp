@@ -0,0 +1,148 @@
+#include "endgameSolver.hpp"
+#include "heuristics.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+constexpr int kHomePosition = 66;
+
+std::array<float, 4> oneHot(PlayerColor winner) {
+  std::array<float, 4> result{};
+  result[static_cast<int>(winner)] = 1;
+  return result;
+}
+
+} // namespace
+
+EndgameSolver::EndgameSolver(int maxPiecesOutsideHome, int maxDistanceToHome, size_t nodeBudget) : maxPiecesOutsideHome_(maxPiecesOutsideHome), maxDistanceToHome_(maxDistanceToHome), nodeBudget_(nodeBudget) {
+  if (maxPiecesOutsideHome < 1 || maxPiecesOutsideHome > 4 || maxDistanceToHome < 1 || nodeBudget < 1) {
+    throw std::runtime_error("Invalid endgame solver limits");
+  }
+}
+
+bool EndgameSolver::isEligible(const Sorry &state) const {
+  for (PlayerColor player : state.getPlayers()) {
+    int piecesOutsideHome = 0;
+    int distance = 0;
+    for (int position : state.getPiecePositionsForPlayer(player)) {
+      if (position != kHomePosition) {
+        ++piecesOutsideHome;
+        distance += state.distanceToHome(player, position);
+      }
+    }
+    if (piecesOutsideHome <= maxPiecesOutsideHome_ && distance <= maxDistanceToHome_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<std::array<float, 4>> EndgameSolver::solve(const Sorry &state, Solutions *deferredSolutions) {
+  Search search;
+  search.deferredSolutions = deferredSolutions;
+  return value(state, search);
+}
+
+void EndgameSolver::remember(const Solutions &solutions) {
+  for (const auto &[key, winProbabilities] : solutions) {
+    remember(key, winProbabilities);
+  }
+}
+
+std::optional<std::array<float, 4>> EndgameSolver::value(const Sorry &state, Search &search) {
+  if (state.gameDone()) {
+    return oneHot(state.getWinner());
+  }
+  const uint64_t key = state.hash();
+  if (const auto winProbabilities = lookUp(key, search.deferredSolutions)) {
+    return winProbabilities;
+  }
+  if (++search.nodeCount > nodeBudget_ || !search.line.insert(key).second) {
+    // Out of budget, or a line of play which comes back to where it was; a value would need solving for a fixed point.
+    return std::nullopt;
+  }
+  const int mover = static_cast<int>(state.getPlayerTurn());
+  // Most promising first, so that a sure win is found before anything else is expanded.
+  std::vector<std::pair<double, Action>> orderedActions;
+  for (const Action &action : state.getActions()) {
+    orderedActions.emplace_back(actionPrior(state, action), action);
+  }
+  std::stable_sort(orderedActions.begin(), orderedActions.end(), [](const auto &lhs, const auto &rhs) { return lhs.first > rhs.first; });
+  if (orderedActions.empty()) {
+    search.line.erase(key);
+    return std::nullopt;
+  }
+  const auto cardCounts = state.getFaceDownCardCounts();
+  int deckSize = 0;
+  for (const auto &[card, count] : cardCounts) {
+    deckSize += count;
+  }
+  std::optional<std::array<float, 4>> best;
+  for (const auto &[prior, action] : orderedActions) {
+    std::array<float, 4> expected{};
+    for (const auto &[card, count] : cardCounts) {
+      Sorry next = state;
+      next.doAction(action, card);
+      if (next.gameDone()) {
+        // Whoever finished did so whatever they drew.
+        expected = oneHot(next.getWinner());
+        break;
+      }
+      const auto nextValue = value(next, search);
+      if (!nextValue) {
+        search.line.erase(key);
+        return std::nullopt;
+      }
+      const float probability = static_cast<float>(count) / deckSize;
+      for (size_t i=0; i<expected.size(); ++i) {
+        expected[i] += probability * (*nextValue)[i];
+      }
+    }
+    if (!best || expected[mover] > (*best)[mover]) {
+      best = expected;
+    }
+    if ((*best)[mover] >= 1) {
+      // Nothing beats a certain win.
+      break;
+    }
+  }
+  search.line.erase(key);
+  // Only exact values get here: every line below ended the game without coming back to a position on it.
+  if (search.deferredSolutions != nullptr) {
+    search.deferredSolutions->emplace(key, *best);
+  } else {
+    remember(key, *best);
+  }
+  return best;
+}
+
+std::optional<std::array<float, 4>> EndgameSolver::lookUp(uint64_t key, const Solutions *deferredSolutions) {
+  if (deferredSolutions != nullptr) {
+    const auto it = deferredSolutions->find(key);
+    if (it != deferredSolutions->end()) {
+      return it->second;
+    }
+  }
+  Shard &shard = shards_[key % kShardCount];
+  std::lock_guard guard(shard.mutex);
+  const auto it = shard.results.find(key);
+  if (it == shard.results.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void EndgameSolver::remember(uint64_t key, const std::array<float, 4> &winProbabilities) {
+  Shard &shard = shards_[key % kShardCount];
+  std::lock_guard guard(shard.mutex);
+  if (shard.results.size() >= kMaxEntriesPerShard) {
+    shard.results.clear();
+  }
+  shard.results[key] = winProbabilities;
+}
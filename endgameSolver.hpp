@@ -0,0 +1,55 @@
+#ifndef ENDGAME_SOLVER_HPP_
+#define ENDGAME_SOLVER_HPP_
+
+#include "sorry.hpp"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+// Computes exact win probabilities of positions close to the end of the game, by expectimax over every action and every card which could be drawn after it.
+//
+// Each player is assumed to pick the action which maximizes their own win probability (max^n), with the first such action winning ties. A position is solved only if the whole game tree below it fits in the node budget and never repeats a position along a line of play; otherwise there is no answer, rather than an approximate one.
+//
+// Solved positions are remembered across calls; positions it could not solve are tried again, since whether they fit in the budget depends on what has been remembered since. Safe to use from several threads at once.
+class EndgameSolver {
+public:
+  // Positions solved by a `solve` which defers remembering them, with their win probabilities.
+  using Solutions = std::unordered_map<uint64_t, std::array<float, 4>>;
+  // `maxPiecesOutsideHome` and `maxDistanceToHome` say which positions are worth trying; see `isEligible`. `nodeBudget` is the number of positions one `solve` may expand.
+  EndgameSolver(int maxPiecesOutsideHome, int maxDistanceToHome, size_t nodeBudget);
+  // Whether some player has at most `maxPiecesOutsideHome` pieces not yet home, which together are at most `maxDistanceToHome` steps from home. Further from the end, the game tree is practically never small enough.
+  bool isEligible(const sorry::Sorry &state) const;
+  // The probability of each player winning, by PlayerColor, or nullopt if the position can't be solved within the budget. If `deferredSolutions` is given, the positions solved on the way are added to it instead of being remembered, so that concurrent calls don't affect each other's results; pass it to `remember` afterwards.
+  std::optional<std::array<float, 4>> solve(const sorry::Sorry &state, Solutions *deferredSolutions = nullptr);
+  // Remembers the solutions which `solve` deferred.
+  void remember(const Solutions &solutions);
+private:
+  // The memo is split into shards, each with its own lock, so that threads rarely wait for each other. A shard which fills up is simply cleared.
+  static constexpr size_t kShardCount = 64;
+  static constexpr size_t kMaxEntriesPerShard = 1 << 14;
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::array<float, 4>> results;
+  };
+  const int maxPiecesOutsideHome_;
+  const int maxDistanceToHome_;
+  const size_t nodeBudget_;
+  std::array<Shard, kShardCount> shards_;
+
+  // The state of one `solve`.
+  struct Search {
+    size_t nodeCount{0};
+    // Positions on the current line of play, to detect repetition.
+    std::unordered_set<uint64_t> line;
+    Solutions *deferredSolutions;
+  };
+  std::optional<std::array<float, 4>> value(const sorry::Sorry &state, Search &search);
+  std::optional<std::array<float, 4>> lookUp(uint64_t key, const Solutions *deferredSolutions);
+  void remember(uint64_t key, const std::array<float, 4> &winProbabilities);
+};
+
+#endif // ENDGAME_SOLVER_HPP_
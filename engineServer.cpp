@@ -0,0 +1,300 @@
+#include "common.hpp"
+#include "engineServer.hpp"
+#include "timeManager.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+constexpr std::array<PlayerColor, 4> kColors = {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue, PlayerColor::kYellow};
+constexpr std::array<Card, 11> kCards = {Card::kOne, Card::kTwo, Card::kThree, Card::kFour, Card::kFive, Card::kSeven, Card::kEight, Card::kTen, Card::kEleven, Card::kTwelve, Card::kSorry};
+
+std::string lowercase(std::string_view text) {
+  std::string result(text);
+  std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return std::tolower(c); });
+  return result;
+}
+
+PlayerColor parseColor(const std::string &text) {
+  for (PlayerColor color : kColors) {
+    if (lowercase(toString(color)) == lowercase(text)) {
+      return color;
+    }
+  }
+  throw std::runtime_error("Unknown color \"" + text + "\"");
+}
+
+// The number on the card, or "sorry".
+std::string cardToText(Card card) {
+  if (card == Card::kSorry) {
+    return "sorry";
+  }
+  if (card == Card::kFour) {
+    return "4";
+  }
+  return std::to_string(static_cast<int>(card));
+}
+
+Card parseCard(const std::string &text) {
+  for (Card card : kCards) {
+    if (cardToText(card) == lowercase(text)) {
+      return card;
+    }
+  }
+  throw std::runtime_error("Unknown card \"" + text + "\"");
+}
+
+std::vector<std::string> split(const std::string &text, char separator) {
+  std::vector<std::string> fields;
+  size_t start = 0;
+  while (true) {
+    const size_t end = text.find(separator, start);
+    fields.push_back(text.substr(start, end-start));
+    if (end == std::string::npos) {
+      return fields;
+    }
+    start = end+1;
+  }
+}
+
+int parseInt(const std::string &text) {
+  size_t length;
+  const int value = std::stoi(text, &length);
+  if (length != text.size()) {
+    throw std::runtime_error("Expected a number, got \"" + text + "\"");
+  }
+  return value;
+}
+
+// Parses COLOR:P,P,P,P:C,C,C,C,C into `state`, which must already have the color.
+void parseHand(const std::string &text, Sorry &state) {
+  const std::vector<std::string> fields = split(text, ':');
+  if (fields.size() != 3) {
+    throw std::runtime_error("Expected COLOR:POSITIONS:CARDS, got \"" + text + "\"");
+  }
+  const PlayerColor color = parseColor(fields[0]);
+  const std::vector<std::string> positionFields = split(fields[1], ',');
+  const std::vector<std::string> cardFields = split(fields[2], ',');
+  std::array<int, 4> positions;
+  std::array<Card, 5> cards;
+  if (positionFields.size() != positions.size() || cardFields.size() != cards.size()) {
+    throw std::runtime_error("Expected 4 positions and 5 cards for " + fields[0]);
+  }
+  for (size_t i=0; i<positions.size(); ++i) {
+    positions[i] = parseInt(positionFields[i]);
+    if (positions[i] < 0 || positions[i] > 66) {
+      throw std::runtime_error("Position " + positionFields[i] + " is off the board");
+    }
+  }
+  for (size_t i=0; i<cards.size(); ++i) {
+    cards[i] = parseCard(cardFields[i]);
+  }
+  state.setStartingPositions(color, positions);
+  state.setStartingCards(color, cards);
+}
+
+std::string describePosition(const Sorry &state) {
+  std::stringstream ss;
+  ss << "position " << lowercase(toString(state.getPlayerTurn()));
+  for (PlayerColor color : state.getPlayers()) {
+    ss << ' ' << lowercase(toString(color)) << ':';
+    const auto positions = state.getPiecePositionsForPlayer(color);
+    for (size_t i=0; i<positions.size(); ++i) {
+      ss << (i == 0 ? "" : ",") << positions[i];
+    }
+    ss << ':';
+    const auto hand = state.getHandForPlayer(color);
+    for (size_t i=0; i<hand.size(); ++i) {
+      ss << (i == 0 ? "" : ",") << cardToText(hand[i]);
+    }
+  }
+  return ss.str();
+}
+
+} // namespace
+
+// The thread handling requests searches too, so the pool only needs the others.
+EngineServer::EngineServer(double explorationConstant, int threadCount) : explorationConstant_(explorationConstant), threadCount_(threadCount) {
+  if (threadCount > 1) {
+    // The thread calling `run` is the first searcher.
+    pool_ = std::make_unique<ThreadPool>(threadCount-1);
+  }
+}
+
+EngineServer::~EngineServer() = default;
+
+void EngineServer::serve(std::istream &in, std::ostream &out) {
+  std::string request;
+  bool quit = false;
+  while (!quit && std::getline(in, request)) {
+    if (request.empty()) {
+      continue;
+    }
+    const std::string response = handleRequest(request, quit);
+    if (!quit) {
+      // Flushed per response, since the client waits for it before sending more.
+      out << response << std::endl;
+    }
+  }
+}
+
+std::string EngineServer::handleRequest(const std::string &request, bool &quit) {
+  std::istringstream words(request);
+  std::string command;
+  words >> command;
+  try {
+    if (command == "quit") {
+      quit = true;
+      return {};
+    }
+    std::string tableName;
+    if (!(words >> tableName)) {
+      throw std::runtime_error("Missing table");
+    }
+    if (command == "new") {
+      std::vector<PlayerColor> colors;
+      std::string colorName;
+      while (words >> colorName) {
+        colors.push_back(parseColor(colorName));
+      }
+      if (colors.size() < 2) {
+        throw std::runtime_error("Need at least 2 colors");
+      }
+      Sorry state(colors);
+      Table &table = createTable(tableName, state);
+      table.state.drawRandomStartingCards(table.eng);
+      return "ok";
+    }
+    if (command == "position") {
+      std::string turnName;
+      if (!(words >> turnName)) {
+        throw std::runtime_error("Missing turn");
+      }
+      std::vector<std::string> hands;
+      std::vector<PlayerColor> colors;
+      std::string hand;
+      while (words >> hand) {
+        colors.push_back(parseColor(hand.substr(0, hand.find(':'))));
+        hands.push_back(hand);
+      }
+      if (colors.size() < 2) {
+        throw std::runtime_error("Need at least 2 hands");
+      }
+      Sorry state(colors);
+      for (const std::string &handText : hands) {
+        parseHand(handText, state);
+      }
+      state.setTurn(parseColor(turnName));
+      createTable(tableName, state);
+      return "ok";
+    }
+    if (command == "close") {
+      if (tables_.erase(tableName) == 0) {
+        throw std::runtime_error("No table \"" + tableName + "\"");
+      }
+      return "ok";
+    }
+    Table &table = getTable(tableName);
+    if (command == "show") {
+      return describePosition(table.state);
+    }
+    if (command == "search") {
+      std::string unit;
+      std::string amountText;
+      if (!(words >> unit >> amountText)) {
+        throw std::runtime_error("Expected iterations N, ms N or clock N");
+      }
+      const int amount = parseInt(amountText);
+      if (amount <= 0) {
+        throw std::runtime_error("Search amount must be positive");
+      }
+      if (table.state.gameDone()) {
+        throw std::runtime_error("Game is over");
+      }
+      // Early stopping is only worth it when the time saved goes back on a clock.
+      table.mcts->setEarlyStopping(unit == "clock");
+      if (unit == "iterations") {
+        table.mcts->run(table.state, amount);
+      } else if (unit == "clock") {
+        table.mcts->run(table.state, TimeManager(std::chrono::milliseconds(amount)).budgetFor(table.state));
+      } else if (unit == "ms") {
+        table.mcts->run(table.state, std::chrono::milliseconds(amount));
+      } else {
+        throw std::runtime_error("Unknown search limit \"" + unit + "\"");
+      }
+      std::stringstream ss;
+      ss << "best " << table.mcts->pickBestAction().pack() << " winrates";
+      for (double winRate : table.mcts->getWinRates()) {
+        ss << ' ' << winRate;
+      }
+      ss << " actions";
+      for (const ActionScore &actionScore : table.mcts->getActionScores()) {
+        ss << ' ' << actionScore.action.pack() << ':' << actionScore.visitCount << ':' << actionScore.score;
+      }
+      ss << " stats " << table.mcts->getSearchStats().toJson();
+      return ss.str();
+    }
+    if (command == "play") {
+      std::string actionText;
+      std::string cardText;
+      if (!(words >> actionText)) {
+        throw std::runtime_error("Missing action");
+      }
+      if (!(words >> cardText)) {
+        throw std::runtime_error("Missing drawn card");
+      }
+      if (table.state.gameDone()) {
+        throw std::runtime_error("Game is over");
+      }
+      const Action action = Action::unpack(static_cast<uint32_t>(std::stoul(actionText)));
+      const std::vector<Action> actions = table.state.getActions();
+      if (std::find(actions.begin(), actions.end(), action) == actions.end()) {
+        throw std::runtime_error("Action " + actionText + " is not legal");
+      }
+      const Card drawnCard = parseCard(cardText);
+      const auto cardCounts = table.state.getFaceDownCardCounts();
+      if (std::none_of(cardCounts.begin(), cardCounts.end(), [&](const auto &cardAndCount) { return cardAndCount.first == drawnCard; })) {
+        throw std::runtime_error("No " + cardToText(drawnCard) + " is left in the deck");
+      }
+      table.state.doAction(action, drawnCard);
+      // The tree is kept, so the next search continues from the part of it below this action.
+      if (table.state.gameDone()) {
+        return "done " + lowercase(toString(table.state.getWinner()));
+      }
+      return "ok " + lowercase(toString(table.state.getPlayerTurn()));
+    }
+    throw std::runtime_error("Unknown command \"" + command + "\"");
+  } catch (const std::exception &e) {
+    return std::string("error ") + e.what();
+  }
+}
+
+EngineServer::Table& EngineServer::getTable(const std::string &name) {
+  auto it = tables_.find(name);
+  if (it == tables_.end()) {
+    throw std::runtime_error("No table \"" + name + "\"");
+  }
+  return it->second;
+}
+
+EngineServer::Table& EngineServer::createTable(const std::string &name, Sorry state) {
+  auto it = tables_.find(name);
+  if (it == tables_.end()) {
+    auto mcts = std::make_unique<SorryMcts>(explorationConstant_);
+    mcts->setThreadCount(threadCount_);
+    mcts->setThreadPool(pool_.get());
+    it = tables_.emplace(name, Table{std::move(state), std::move(mcts), createRandomEngine()}).first;
+  } else {
+    // Keep the search object; its tree is dropped since the new position is unrelated.
+    it->second.state = std::move(state);
+    it->second.mcts->reset();
+  }
+  return it->second;
+}
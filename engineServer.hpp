@@ -0,0 +1,54 @@
+#ifndef ENGINE_SERVER_HPP_
+#define ENGINE_SERVER_HPP_
+
+#include "sorry.hpp"
+#include "sorryMcts.hpp"
+#include "threadPool.hpp"
+
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+// A long-running engine which keeps one game, search tree and thread pool per table across requests, so that each decision doesn't start from scratch.
+//
+// Requests and responses are one line each. Words are separated by spaces, and TABLE is any name the client picks.
+//   new TABLE COLOR...                  Starts a game between COLORs with random starting hands.        -> ok
+//   position TABLE TURN HAND...         Sets up a position. Each HAND is COLOR:P,P,P,P:C,C,C,C,C with   -> ok
+//                                       the color's piece positions (0 is start, 66 is home) and cards
+//                                       (1, 2, 3, 4, 5, 7, 8, 10, 11, 12 or sorry).
+//   search TABLE iterations N           Searches the table's position.                                  -> best ACTION winrates W W W W actions ACTION:VISITS:SCORE... stats JSON
+//   search TABLE ms N                   JSON is the search's SearchStats, on the same line.
+//   search TABLE clock N                With N ms left for the game, searches for this move's share of
+//                                       them (see TimeManager), stopping once the pick can't change.
+//   play TABLE ACTION CARD              Plays ACTION, replacing the card used with CARD, the one the    -> ok TURN, or done WINNER
+//                                       player drew, which must still be face down.
+//   show TABLE                          Describes the table's position, in the form `position` takes.   -> position TURN HAND...
+//   close TABLE                                                                                          -> ok
+//   quit
+// ACTIONs are given in their packed form (see Action::pack). Win rates are for green, red, blue and yellow. Failed requests get `error MESSAGE`.
+class EngineServer {
+public:
+  EngineServer(double explorationConstant, int threadCount);
+  ~EngineServer();
+  // Answers requests from `in` on `out` until `quit` or the end of `in`.
+  void serve(std::istream &in, std::ostream &out);
+  // Answers a single request. Sets `quit` if it was `quit`.
+  std::string handleRequest(const std::string &request, bool &quit);
+private:
+  struct Table {
+    sorry::Sorry state;
+    std::unique_ptr<SorryMcts> mcts;
+    std::mt19937 eng;
+  };
+  const double explorationConstant_;
+  const int threadCount_;
+  // Every table searches on it, so that threads aren't started for each search. Null when searching with a single thread, which needs no helpers. Declared before the tables so that it outlives them.
+  std::unique_ptr<ThreadPool> pool_;
+  std::map<std::string, Table> tables_;
+  Table& getTable(const std::string &name);
+  Table& createTable(const std::string &name, sorry::Sorry state);
+};
+
+#endif // ENGINE_SERVER_HPP_
@@ -0,0 +1,205 @@
+#include "expectimaxSearch.hpp"
+#include "heuristics.hpp"
+#include "sorry.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace sorry;
+
+ExpectimaxSearch::Result ExpectimaxSearch::search(const Sorry &state, int maxDepth, std::optional<std::chrono::steady_clock::time_point> deadline) {
+  if (maxDepth < 1) {
+    throw std::runtime_error("Expectimax depth must be at least 1");
+  }
+  ourPlayer_ = state.getPlayerTurn();
+  deadline_ = deadline;
+  nodeCount_ = 0;
+  outOfTime_ = false;
+  std::vector<Action> actions = orderedActions(state);
+  if (actions.empty()) {
+    throw std::runtime_error("No actions to take");
+  }
+  Result result{actions.front(), leafValue(state), 0, 0};
+  if (actions.size() == 1) {
+    // Nothing to decide.
+    return result;
+  }
+  for (int depth=1; depth<=maxDepth; ++depth) {
+    Action bestAction = actions.front();
+    const double value = searchRoot(state, actions, depth, bestAction);
+    if (outOfTime_) {
+      break;
+    }
+    result = Result{bestAction, value, depth, nodeCount_};
+    if (value >= 1) {
+      // A certain win; looking deeper can't find anything better.
+      break;
+    }
+    // The best action so far narrows the window for the others soonest.
+    std::stable_partition(actions.begin(), actions.end(), [&](const Action &action) { return action == bestAction; });
+  }
+  result.nodeCount = nodeCount_;
+  return result;
+}
+
+double ExpectimaxSearch::searchRoot(const Sorry &state, const std::vector<Action> &actions, int depth, Action &bestAction) {
+  double best = 0;
+  for (size_t i=0; i<actions.size(); ++i) {
+    // The first action gets a full window, so that its value is exact even if every action is a certain loss.
+    const double value = chanceValue(state, actions[i], depth, (i == 0 ? 0 : best), 1);
+    if (outOfTime_) {
+      return 0;
+    }
+    if (i == 0 || value > best) {
+      best = value;
+      bestAction = actions[i];
+    }
+    if (best >= 1) {
+      break;
+    }
+  }
+  return best;
+}
+
+double ExpectimaxSearch::decisionValue(const Sorry &state, int depth, double alpha, double beta) {
+  if (checkTime()) {
+    return 0;
+  }
+  if (state.gameDone() || depth == 0) {
+    return leafValue(state);
+  }
+  const bool maximizing = (state.getPlayerTurn() == ourPlayer_);
+  double best = (maximizing ? 0 : 1);
+  for (const Action &action : orderedActions(state)) {
+    if (maximizing) {
+      best = std::max(best, chanceValue(state, action, depth, std::max(alpha, best), beta));
+    } else {
+      best = std::min(best, chanceValue(state, action, depth, alpha, std::min(beta, best)));
+    }
+    if (outOfTime_) {
+      return 0;
+    }
+    if (maximizing ? best >= beta : best <= alpha) {
+      break;
+    }
+  }
+  return best;
+}
+
+double ExpectimaxSearch::chanceValue(const Sorry &state, const Action &action, int depth, double alpha, double beta) {
+  const auto cardCounts = state.getFaceDownCardCounts();
+  int deckSize = 0;
+  for (const auto &[card, count] : cardCounts) {
+    deckSize += count;
+  }
+  std::vector<Sorry> outcomes;
+  std::vector<double> probabilities;
+  outcomes.reserve(cardCounts.size());
+  probabilities.reserve(cardCounts.size());
+  for (const auto &[card, count] : cardCounts) {
+    Sorry next = state;
+    next.doAction(action, card);
+    if (next.gameDone()) {
+      // Whoever finished did so whatever they drew.
+      return leafValue(next);
+    }
+    outcomes.push_back(std::move(next));
+    probabilities.push_back(static_cast<double>(count) / deckSize);
+  }
+  const int childDepth = depth-1;
+  // What each outcome is known to be within. Values are probabilities, so at first, nothing more than [0, 1].
+  std::vector<double> lowerBounds(outcomes.size(), 0);
+  std::vector<double> upperBounds(outcomes.size(), 1);
+  double lowerSum = 0;
+  double upperSum = 1;
+
+  if (childDepth > 0) {
+    // Star2: probe every outcome with only its most promising action. That bounds the outcome from below if the player to move there is us, who can do at least that well, and from above otherwise. Every outcome has the same player to move, since the drawn card doesn't change whose turn it is.
+    const bool maximizing = (outcomes.front().getPlayerTurn() == ourPlayer_);
+    for (size_t i=0; i<outcomes.size(); ++i) {
+      const double p = probabilities[i];
+      const Action probeAction = orderedActions(outcomes[i]).front();
+      if (maximizing) {
+        // Only needs to be exact up to the value which would cut off this node.
+        const double probeBeta = std::min(1.0, (beta - (lowerSum - p*lowerBounds[i])) / p);
+        lowerBounds[i] = chanceValue(outcomes[i], probeAction, childDepth, 0, probeBeta);
+      } else {
+        const double probeAlpha = std::max(0.0, (alpha - (upperSum - p*upperBounds[i])) / p);
+        upperBounds[i] = chanceValue(outcomes[i], probeAction, childDepth, probeAlpha, 1);
+      }
+      if (outOfTime_) {
+        return 0;
+      }
+      if (maximizing) {
+        lowerSum += p*lowerBounds[i];
+        if (lowerSum >= beta) {
+          return lowerSum;
+        }
+      } else {
+        upperSum -= p*(1-upperBounds[i]);
+        if (upperSum <= alpha) {
+          return upperSum;
+        }
+      }
+    }
+  }
+
+  // Star1: search the outcomes one at a time, each with the window outside which this node's value is decided whatever the outcomes not yet searched turn out to be.
+  double exactSum = 0;
+  for (size_t i=0; i<outcomes.size(); ++i) {
+    const double p = probabilities[i];
+    // Now the bounds of the outcomes after this one.
+    lowerSum -= p*lowerBounds[i];
+    upperSum -= p*upperBounds[i];
+    if (exactSum + p*upperBounds[i] + upperSum <= alpha) {
+      return exactSum + p*upperBounds[i] + upperSum;
+    }
+    if (exactSum + p*lowerBounds[i] + lowerSum >= beta) {
+      return exactSum + p*lowerBounds[i] + lowerSum;
+    }
+    const double childAlpha = (alpha - exactSum - upperSum) / p;
+    const double childBeta = (beta - exactSum - lowerSum) / p;
+    const double value = decisionValue(outcomes[i], childDepth, std::max(0.0, childAlpha), std::min(1.0, childBeta));
+    if (outOfTime_) {
+      return 0;
+    }
+    if (value <= childAlpha) {
+      return exactSum + p*value + upperSum;
+    }
+    if (value >= childBeta) {
+      return exactSum + p*value + lowerSum;
+    }
+    exactSum += p*value;
+  }
+  return exactSum;
+}
+
+double ExpectimaxSearch::leafValue(const Sorry &state) const {
+  if (state.gameDone()) {
+    return (state.getWinner() == ourPlayer_ ? 1 : 0);
+  }
+  return evaluatePosition(state)[static_cast<int>(ourPlayer_)];
+}
+
+std::vector<Action> ExpectimaxSearch::orderedActions(const Sorry &state) {
+  std::vector<std::pair<double, Action>> scoredActions;
+  for (const Action &action : state.getActions()) {
+    scoredActions.emplace_back(actionPrior(state, action), action);
+  }
+  std::stable_sort(scoredActions.begin(), scoredActions.end(), [](const auto &lhs, const auto &rhs) { return lhs.first > rhs.first; });
+  std::vector<Action> actions;
+  actions.reserve(scoredActions.size());
+  for (const auto &scoredAction : scoredActions) {
+    actions.push_back(scoredAction.second);
+  }
+  return actions;
+}
+
+bool ExpectimaxSearch::checkTime() {
+  ++nodeCount_;
+  if (deadline_ && nodeCount_ % kNodesBetweenClockChecks == 0 && std::chrono::steady_clock::now() >= *deadline_) {
+    outOfTime_ = true;
+  }
+  return outOfTime_;
+}
@@ -0,0 +1,50 @@
+#ifndef EXPECTIMAX_SEARCH_HPP_
+#define EXPECTIMAX_SEARCH_HPP_
+
+#include "action.hpp"
+#include "playerColor.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace sorry {
+class Sorry;
+} // namespace sorry
+
+// Depth-limited expectimax, an alternative to MCTS for short-horizon decisions.
+//
+// After each action, the card the player draws is a chance event, weighted by how many of each card are face down. Positions at the depth limit are scored with evaluatePosition. With more than two players the search is paranoid: it maximizes our own win probability and assumes every opponent tries to minimize it.
+//
+// Since values are probabilities in [0, 1], chance nodes are pruned with Star1, which stops once the outcomes searched so far decide the node whatever the rest turn out to be, and Star2, which first probes every outcome with only its most promising action to get cheap bounds. Actions are tried in order of actionPrior, with the best action of the previous depth first at the root.
+class ExpectimaxSearch {
+public:
+  struct Result {
+    sorry::Action bestAction;
+    // Our estimated win probability after `bestAction`.
+    double value;
+    // The deepest fully searched depth, in plies. 0 if not even the first finished, in which case `bestAction` is the one actionPrior likes best.
+    int depth;
+    uint64_t nodeCount;
+  };
+  // Search `state` to depth 1, 2, ..., `maxDepth` plies, returning the result of the deepest search which finished by `deadline`, if any.
+  Result search(const sorry::Sorry &state, int maxDepth, std::optional<std::chrono::steady_clock::time_point> deadline);
+private:
+  static constexpr uint64_t kNodesBetweenClockChecks = 256;
+  sorry::PlayerColor ourPlayer_;
+  std::optional<std::chrono::steady_clock::time_point> deadline_;
+  uint64_t nodeCount_;
+  bool outOfTime_;
+
+  // Values are fail-soft: a value at most `alpha` is an upper bound on the true value, and one at least `beta` is a lower bound.
+  double searchRoot(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, int depth, sorry::Action &bestAction);
+  double decisionValue(const sorry::Sorry &state, int depth, double alpha, double beta);
+  double chanceValue(const sorry::Sorry &state, const sorry::Action &action, int depth, double alpha, double beta);
+  double leafValue(const sorry::Sorry &state) const;
+  // Actions sorted best first by actionPrior.
+  static std::vector<sorry::Action> orderedActions(const sorry::Sorry &state);
+  bool checkTime();
+};
+
+#endif // EXPECTIMAX_SEARCH_HPP_
@@ -0,0 +1,87 @@
+#include "heuristics.hpp"
+#include "sorry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace sorry;
+
+namespace {
+
+// Weights, in units of squares of progress.
+constexpr double kReachHomeBonus = 6.0;
+constexpr double kLeaveStartBonus = 4.0;
+constexpr double kSendOpponentToStartBonus = 4.0;
+
+// Evaluation, in units of squares left to go. Leaving start needs a 1, 2, or Sorry card, so a piece there is further from home than its distance says. Pieces in the safe zone cannot be sent back, so they are closer than their distance says.
+constexpr double kInStartPenalty = 8.0;
+constexpr double kSafeZoneDiscount = 0.5;
+// How many squares of difference in remaining distance make one player e (about 2.7) times as likely to win as another.
+constexpr double kEvaluationScale = 15.0;
+
+} // namespace
+
+double actionPrior(const Sorry &state, const Action &action) {
+  if (action.actionType == Action::ActionType::kDiscard) {
+    return 0.0;
+  }
+  double prior = 0.0;
+  for (const Sorry::Move &move : state.getMovesForAction(action)) {
+    const int srcDistance = state.distanceToHome(move.playerColor, move.srcPosition);
+    const int destDistance = state.distanceToHome(move.playerColor, move.destPosition);
+    if (move.playerColor == action.playerColor) {
+      // Our own progress. Moving backwards can be a shortcut, in which case this is positive too.
+      prior += srcDistance - destDistance;
+      if (move.destPosition == 66) {
+        prior += kReachHomeBonus;
+      }
+      if (move.srcPosition == 0) {
+        prior += kLeaveStartBonus;
+      }
+    } else {
+      // How far the opponent was set back.
+      prior += destDistance - srcDistance;
+      if (move.destPosition == 0) {
+        prior += kSendOpponentToStartBonus;
+      }
+    }
+  }
+  return prior;
+}
+
+std::array<double, 4> evaluatePosition(const Sorry &state) {
+  std::array<double, 4> result{};
+  if (state.gameDone()) {
+    result[static_cast<int>(state.getWinner())] = 1.0;
+    return result;
+  }
+  const auto players = state.getPlayers();
+  std::array<double, 4> remaining{};
+  double leastRemaining = std::numeric_limits<double>::infinity();
+  for (PlayerColor player : players) {
+    double &playerRemaining = remaining[static_cast<int>(player)];
+    for (int position : state.getPiecePositionsForPlayer(player)) {
+      const double distance = state.distanceToHome(player, position);
+      if (position == 0) {
+        playerRemaining += distance + kInStartPenalty;
+      } else if (position > 60) {
+        playerRemaining += distance * kSafeZoneDiscount;
+      } else {
+        playerRemaining += distance;
+      }
+    }
+    leastRemaining = std::min(leastRemaining, playerRemaining);
+  }
+  // Softmax over the negated distances, shifted by the smallest so that exp() cannot underflow to all zeros.
+  double sum = 0.0;
+  for (PlayerColor player : players) {
+    const int index = static_cast<int>(player);
+    result[index] = std::exp((leastRemaining - remaining[index]) / kEvaluationScale);
+    sum += result[index];
+  }
+  for (double &probability : result) {
+    probability /= sum;
+  }
+  return result;
+}
@@ -0,0 +1,18 @@
+#ifndef HEURISTICS_HPP_
+#define HEURISTICS_HPP_
+
+#include "action.hpp"
+
+#include <array>
+
+namespace sorry {
+class Sorry;
+} // namespace sorry
+
+// A cheap guess at how good `action` is for the player taking it in `state`, without looking ahead. Higher is better; only the order of the values is meaningful.
+double actionPrior(const sorry::Sorry &state, const sorry::Action &action);
+
+// A fast guess at each player's chance of winning from `state`, indexed by player color, based on how far each player's pieces still have to go. Players who are not in the game get 0; the rest sum to 1. A finished game gives its winner 1.
+std::array<double, 4> evaluatePosition(const sorry::Sorry &state);
+
+#endif // HEURISTICS_HPP_
@@ -1,9 +1,21 @@
+#include "agents.hpp"
 #include "common.hpp"
+#include "engineServer.hpp"
+#include "raceTablebase.hpp"
+#include "searchMultiplexer.hpp"
+#include "selfPlay.hpp"
 #include "sorry.hpp"
 #include "sorryMcts.hpp"
+#include "tournament.hpp"
 
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace sorry;
 using namespace std;
@@ -29,58 +41,8 @@ using namespace std;
 //        11       7     4   2  60
 // ======================================
 
-class BaseAgent {
-public:
-  virtual sorry::Action getAction(const sorry::Sorry &state) = 0;
-};
-
-class RandomAgent : public BaseAgent {
-public:
-  RandomAgent() : eng_(createRandomEngine()) {}
-
-  sorry::Action getAction(const sorry::Sorry &state) override {
-    const auto actions = state.getActions();
-    uniform_int_distribution<> dist(0, actions.size()-1);
-    return actions.at(dist(eng_));
-  }
-private:
-  std::mt19937 eng_;
-};
-
-class IterationBoundMctsAgent : public BaseAgent {
-public:
-  IterationBoundMctsAgent(double explorationConstant, int maxIterationCount) : mcts_(explorationConstant), maxIterationCount_(maxIterationCount) {}
-  sorry::Action getAction(const sorry::Sorry &state) override {
-    mcts_.run(state, maxIterationCount_);
-    const sorry::Action action = mcts_.pickBestAction();
-    mcts_.reset();
-    return action;
-  }
-private:
-  SorryMcts mcts_;
-  int maxIterationCount_;
-};
-
-class HumanAgent : public BaseAgent {
-public:
-  HumanAgent() = default;
-  sorry::Action getAction(const sorry::Sorry &state) override {
-    cout << "State: " << state.toString() << endl;
-    const auto actions = state.getActions();
-    for (size_t i=0; i<actions.size(); ++i) {
-      cout << "  " << i << ": " << actions.at(i).toString() << endl;
-    }
-    int choice = -1;
-    while (choice < 0 || choice >= static_cast<int>(actions.size())) {
-      cout << "Please choose [0-" << actions.size()-1 << "]: ";
-      cin >> choice;
-    }
-    return actions.at(choice);
-  }
-private:
-};
-
-sorry::PlayerColor agentVsAgent(const std::map<sorry::PlayerColor, BaseAgent*> &agents) {
+// Agents get until `timePerMove` after their turn starts to move, and may think during the other players' turns.
+sorry::PlayerColor agentVsAgent(const std::map<sorry::PlayerColor, AsyncAgent*> &agents, std::chrono::duration<double> timePerMove) {
   mt19937 eng = createRandomEngine();
   std::vector<sorry::PlayerColor> playerColors;
   playerColors.reserve(agents.size());
@@ -94,9 +56,13 @@ sorry::PlayerColor agentVsAgent(const std::map<sorry::PlayerColor, BaseAgent*> &
   while (!sorry.gameDone()) {
     // Who's turn?
     const PlayerColor currentTurn = sorry.getPlayerTurn();
-    BaseAgent *agent = agents.at(currentTurn);
-    const sorry::Action action = agent->getAction(sorry);
+    AsyncAgent *agent = agents.at(currentTurn);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timePerMove);
+    const sorry::Action action = agent->decide(sorry, deadline).get();
     sorry.doAction(action, eng);
+    if (!sorry.gameDone() && sorry.getPlayerTurn() != currentTurn) {
+      agent->opponentsToMove(sorry, currentTurn);
+    }
     ++turnNumber;
   }
   return sorry.getWinner();
@@ -118,12 +84,239 @@ void doSingleMove() {
   std::cout << "Best action is " << bestAction.toString() << endl;
 }
 
-int main() {
-  HumanAgent agent1;
-  RandomAgent agent2;
-  std::map<sorry::PlayerColor, BaseAgent*> agents = {{sorry::PlayerColor::kGreen, &agent1},
-                                                     {sorry::PlayerColor::kBlue, &agent2}};
-  const sorry::PlayerColor winner = agentVsAgent(agents);
+constexpr double kDefaultExplorationConstant = 2.0;
+constexpr int kDefaultExpectimaxMaxDepth = 8;
+
+void printTournamentUsage() {
+  cerr << "Usage: SorryMCTS tournament [--games N] [--threads N] [--search-threads N] [--pin] [--stats FILE] [--tablebase FILE] AGENT AGENT [AGENT [AGENT]]" << endl;
+  cerr << "  AGENT is one of:" << endl;
+  cerr << "    random" << endl;
+  cerr << "    mcts:ITERATIONS[:EXPLORATION]" << endl;
+  cerr << "    mcts-time:MILLISECONDS[:EXPLORATION]" << endl;
+  cerr << "    mcts-clock:MILLISECONDS_PER_GAME[:EXPLORATION]" << endl;
+  cerr << "    mcts-shared:MILLISECONDS[:EXPLORATION]" << endl;
+  cerr << "    expectimax:DEPTH" << endl;
+  cerr << "    expectimax-time:MILLISECONDS[:MAX_DEPTH]" << endl;
+  cerr << "  EXPLORATION defaults to " << kDefaultExplorationConstant << " and MAX_DEPTH to " << kDefaultExpectimaxMaxDepth << "." << endl;
+  cerr << "  Games run --threads at a time, and MCTS agents search on --search-threads of the same threads." << endl;
+  cerr << "  mcts-shared agents instead take turns searching on --threads more threads, shared by every game." << endl;
+  cerr << "  MCTS agents look up two-player races in the --tablebase written by \"SorryMCTS tablebase\", if given." << endl;
+}
+
+// `multiplexer` is created with `threadCount` threads by the first entry which needs it. `raceTablebase` may be null.
+TournamentEntry parseTournamentEntry(const std::string &spec, int searchThreadCount, int threadCount, std::shared_ptr<SearchMultiplexer> &multiplexer, const RaceTablebase *raceTablebase) {
+  std::vector<std::string> fields;
+  size_t start = 0;
+  while (true) {
+    const size_t colon = spec.find(':', start);
+    fields.push_back(spec.substr(start, colon-start));
+    if (colon == std::string::npos) {
+      break;
+    }
+    start = colon+1;
+  }
+  if (fields[0] == "random" && fields.size() == 1) {
+    return {spec, [](ThreadPool&) { return std::make_unique<RandomAgent>(); }};
+  }
+  if ((fields[0] == "mcts" || fields[0] == "mcts-time" || fields[0] == "mcts-clock" || fields[0] == "mcts-shared") && (fields.size() == 2 || fields.size() == 3)) {
+    const int amount = std::stoi(fields[1]);
+    const double explorationConstant = (fields.size() == 3 ? std::stod(fields[2]) : kDefaultExplorationConstant);
+    if (fields[0] == "mcts") {
+      return {spec, [=](ThreadPool &pool) { return std::make_unique<IterationBoundMctsAgent>(explorationConstant, amount, searchThreadCount, &pool, raceTablebase); }};
+    }
+    if (fields[0] == "mcts-clock") {
+      const std::chrono::milliseconds gameTime(amount);
+      return {spec, [=](ThreadPool &pool) { return std::make_unique<GameClockMctsAgent>(explorationConstant, gameTime, searchThreadCount, &pool, raceTablebase); }};
+    }
+    const std::chrono::milliseconds timePerMove(amount);
+    if (fields[0] == "mcts-shared") {
+      if (!multiplexer) {
+        multiplexer = std::make_shared<SearchMultiplexer>(threadCount);
+      }
+      // Every game's agent holds on to the same multiplexer, which lives as long as the entry.
+      return {spec, [=, multiplexer=multiplexer](ThreadPool&) { return std::make_unique<MultiplexedMctsAgent>(explorationConstant, timePerMove, *multiplexer, raceTablebase); }};
+    }
+    return {spec, [=](ThreadPool &pool) { return std::make_unique<TimeBoundMctsAgent>(explorationConstant, timePerMove, searchThreadCount, &pool, raceTablebase); }};
+  }
+  if (fields[0] == "expectimax" && fields.size() == 2) {
+    const int maxDepth = std::stoi(fields[1]);
+    return {spec, [=](ThreadPool&) { return std::make_unique<ExpectimaxAgent>(maxDepth, std::nullopt); }};
+  }
+  if (fields[0] == "expectimax-time" && (fields.size() == 2 || fields.size() == 3)) {
+    const std::chrono::milliseconds timePerMove(std::stoi(fields[1]));
+    const int maxDepth = (fields.size() == 3 ? std::stoi(fields[2]) : kDefaultExpectimaxMaxDepth);
+    return {spec, [=](ThreadPool&) { return std::make_unique<ExpectimaxAgent>(maxDepth, timePerMove); }};
+  }
+  throw std::runtime_error("Unknown agent \"" + spec + "\"");
+}
+
+// Headless tournament between the agents given on the command line.
+int tournamentMain(int argc, char *argv[]) {
+  TournamentConfig config;
+  config.threadCount = std::max(1u, std::thread::hardware_concurrency());
+  int searchThreadCount = 1;
+  // Outlives the tournament, whose agents use it.
+  std::unique_ptr<RaceTablebase> raceTablebase;
+  try {
+    std::vector<std::string> entrySpecs;
+    for (int i=0; i<argc; ++i) {
+      const std::string arg = argv[i];
+      if ((arg == "--games" || arg == "--threads" || arg == "--search-threads") && i+1 < argc) {
+        const int value = std::stoi(argv[++i]);
+        (arg == "--games" ? config.gameCount : arg == "--threads" ? config.threadCount : searchThreadCount) = value;
+      } else if (arg == "--pin") {
+        config.pinThreads = true;
+      } else if (arg == "--stats" && i+1 < argc) {
+        config.statsPath = argv[++i];
+      } else if (arg == "--tablebase" && i+1 < argc) {
+        raceTablebase = std::make_unique<RaceTablebase>(argv[++i]);
+      } else {
+        entrySpecs.push_back(arg);
+      }
+    }
+    std::shared_ptr<SearchMultiplexer> multiplexer;
+    for (const std::string &entrySpec : entrySpecs) {
+      config.entries.push_back(parseTournamentEntry(entrySpec, searchThreadCount, config.threadCount, multiplexer, raceTablebase.get()));
+    }
+    const TournamentResult result = runTournament(config);
+    cout << result.toString();
+  } catch (const std::exception &e) {
+    cerr << e.what() << endl;
+    printTournamentUsage();
+    return 1;
+  }
+  return 0;
+}
+
+void printSelfPlayUsage() {
+  cerr << "Usage: SorryMCTS selfplay --output FILE [--games N] [--threads N] [--search-threads N] [--pin] [--iterations N] [--players N] [--sampled-moves N] [--seed N] [--stats FILE] [--tablebase FILE]" << endl;
+}
+
+// Writes MCTS self-play games to a training data file. See selfPlay.hpp for the format.
+int selfPlayMain(int argc, char *argv[]) {
+  SelfPlayConfig config;
+  config.threadCount = std::max(1u, std::thread::hardware_concurrency());
+  config.explorationConstant = kDefaultExplorationConstant;
+  std::unique_ptr<RaceTablebase> raceTablebase;
+  try {
+    for (int i=0; i<argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--pin") {
+        config.pinThreads = true;
+        continue;
+      }
+      if (i+1 >= argc) {
+        throw std::runtime_error("Missing value for \"" + arg + "\"");
+      }
+      const std::string value = argv[++i];
+      if (arg == "--output") {
+        config.outputPath = value;
+      } else if (arg == "--games") {
+        config.gameCount = std::stoi(value);
+      } else if (arg == "--threads") {
+        config.threadCount = std::stoi(value);
+      } else if (arg == "--search-threads") {
+        config.searchThreadCount = std::stoi(value);
+      } else if (arg == "--iterations") {
+        config.iterationsPerMove = std::stoi(value);
+      } else if (arg == "--players") {
+        config.playerCount = std::stoi(value);
+      } else if (arg == "--sampled-moves") {
+        config.sampledMoveCount = std::stoi(value);
+      } else if (arg == "--seed") {
+        config.seed = std::stoull(value);
+      } else if (arg == "--stats") {
+        config.statsPath = value;
+      } else if (arg == "--tablebase") {
+        raceTablebase = std::make_unique<RaceTablebase>(value);
+        config.raceTablebase = raceTablebase.get();
+      } else {
+        throw std::runtime_error("Unknown option \"" + arg + "\"");
+      }
+    }
+    if (config.outputPath.empty()) {
+      throw std::runtime_error("No output file given");
+    }
+    const SelfPlayResult result = runSelfPlay(config);
+    cout << result.toString();
+  } catch (const std::exception &e) {
+    cerr << e.what() << endl;
+    printSelfPlayUsage();
+    return 1;
+  }
+  return 0;
+}
+
+// Computes the race tablebase and writes it to a file. See raceTablebase.hpp for the format.
+int tablebaseMain(int argc, char *argv[]) {
+  std::string outputPath;
+  int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  try {
+    for (int i=0; i<argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--output" && i+1 < argc) {
+        outputPath = argv[++i];
+      } else if (arg == "--threads" && i+1 < argc) {
+        threadCount = std::stoi(argv[++i]);
+      } else {
+        throw std::runtime_error("Unknown option \"" + arg + "\"");
+      }
+    }
+    if (outputPath.empty()) {
+      throw std::runtime_error("No output file given");
+    }
+    RaceTablebase::generate(outputPath, threadCount);
+  } catch (const std::exception &e) {
+    cerr << e.what() << endl;
+    cerr << "Usage: SorryMCTS tablebase --output FILE [--threads N]" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Serves requests on stdin and stdout until told to quit. See engineServer.hpp for the protocol.
+int serverMain(int argc, char *argv[]) {
+  int threadCount = 1;
+  double explorationConstant = kDefaultExplorationConstant;
+  try {
+    for (int i=0; i<argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--threads" && i+1 < argc) {
+        threadCount = std::stoi(argv[++i]);
+      } else if (arg == "--exploration" && i+1 < argc) {
+        explorationConstant = std::stod(argv[++i]);
+      } else {
+        throw std::runtime_error("Unknown option \"" + arg + "\"");
+      }
+    }
+  } catch (const std::exception &e) {
+    cerr << e.what() << endl;
+    cerr << "Usage: SorryMCTS server [--threads N] [--exploration C]" << endl;
+    return 1;
+  }
+  EngineServer server(explorationConstant, threadCount);
+  server.serve(std::cin, std::cout);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "tournament") {
+    return tournamentMain(argc-2, argv+2);
+  }
+  if (argc > 1 && std::string(argv[1]) == "selfplay") {
+    return selfPlayMain(argc-2, argv+2);
+  }
+  if (argc > 1 && std::string(argv[1]) == "tablebase") {
+    return tablebaseMain(argc-2, argv+2);
+  }
+  if (argc > 1 && std::string(argv[1]) == "server") {
+    return serverMain(argc-2, argv+2);
+  }
+  AsyncAgentAdapter agent1(std::make_unique<HumanAgent>());
+  AsyncAgentAdapter agent2(std::make_unique<RandomAgent>());
+  std::map<sorry::PlayerColor, AsyncAgent*> agents = {{sorry::PlayerColor::kGreen, &agent1},
+                                                      {sorry::PlayerColor::kBlue, &agent2}};
+  const sorry::PlayerColor winner = agentVsAgent(agents, std::chrono::seconds(1));
   std::cout << toString(winner) << " won" << std::endl;
   return 0;
 }
\ No newline at end of file
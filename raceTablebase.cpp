@@ -0,0 +1,293 @@
+#include "raceTablebase.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sorry;
+
+namespace {
+
+constexpr char kMagic[] = "SRYRACE1";
+constexpr int kFirstSafeZonePosition = 61;
+constexpr int kHomePosition = 66;
+constexpr int kHandSize = 5;
+constexpr double kConvergenceThreshold = 1e-7;
+constexpr int kMaxIterationCount = 100000;
+
+std::array<int, 4> positionsForSide(int side) {
+  std::array<int, 4> positions;
+  positions.fill(kHomePosition);
+  size_t pieceIndex = 0;
+  for (int distance=1; distance<=kHomePosition-kFirstSafeZonePosition; ++distance) {
+    if (side & (1 << (distance-1))) {
+      positions.at(pieceIndex++) = kHomePosition-distance;
+    }
+  }
+  return positions;
+}
+
+bool hostIsLittleEndian() {
+  const uint32_t one = 1;
+  unsigned char firstByte;
+  std::memcpy(&firstByte, &one, 1);
+  return firstByte == 1;
+}
+
+void writeU32(std::ofstream &output, uint32_t value) {
+  const char bytes[4] = {static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF), static_cast<char>((value >> 16) & 0xFF), static_cast<char>(value >> 24)};
+  output.write(bytes, sizeof(bytes));
+}
+
+uint32_t readU32(const char *data) {
+  const auto *bytes = reinterpret_cast<const unsigned char*>(data);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// The probability that a hand dealt from a full deck holds none of `cardCount` particular cards.
+double probabilityOfMissing(int cardCount, int deckSize) {
+  double probability = 1;
+  for (int i=0; i<kHandSize; ++i) {
+    probability *= std::max(0, deckSize-cardCount-i) / static_cast<double>(deckSize-i);
+  }
+  return probability;
+}
+
+} // namespace
+
+std::optional<int> RaceTablebase::sideIndex(const std::array<int, 4> &positions) {
+  int side = 0;
+  for (int position : positions) {
+    if (position == kHomePosition) {
+      continue;
+    }
+    if (position < kFirstSafeZonePosition || position > kHomePosition) {
+      return std::nullopt;
+    }
+    side |= 1 << (kHomePosition-position-1);
+  }
+  return side;
+}
+
+void RaceTablebase::generate(const std::string &path, int threadCount) {
+  if (threadCount < 1) {
+    throw std::runtime_error("Thread count must be at least 1");
+  }
+  // The cards of a full deck, and how many of each.
+  const std::vector<std::pair<Card, int>> cardCounts = Sorry({PlayerColor::kGreen, PlayerColor::kRed}).getFaceDownCardCounts();
+  int deckSize = 0;
+  for (const auto &cardAndCount : cardCounts) {
+    deckSize += cardAndCount.second;
+  }
+
+  // Where each card can take each side, found by playing it in a real game: the side after the move, and whether the mover goes again.
+  std::vector<std::vector<std::vector<std::pair<int, bool>>>> successors(kSideCount, std::vector<std::vector<std::pair<int, bool>>>(cardCounts.size()));
+  for (int side=1; side<kSideCount; ++side) {
+    for (size_t cardIndex=0; cardIndex<cardCounts.size(); ++cardIndex) {
+      const Card card = cardCounts[cardIndex].first;
+      Sorry state({PlayerColor::kGreen, PlayerColor::kRed});
+      state.setStartingPositions(PlayerColor::kGreen, positionsForSide(side));
+      // Red stays in start, where it can't interact with Green's safe zone, but the game isn't over.
+      state.setStartingPositions(PlayerColor::kRed, {0, 0, 0, 0});
+      // Fill the hands with every other kind of card, which we ignore.
+      std::array<Card, kHandSize> greenHand{card};
+      std::array<Card, kHandSize> redHand;
+      size_t otherCount = 0;
+      for (const auto &cardAndCount : cardCounts) {
+        if (cardAndCount.first == card) {
+          continue;
+        }
+        if (otherCount == 2*kHandSize-1) {
+          break;
+        }
+        (otherCount < kHandSize-1 ? greenHand[otherCount+1] : redHand[otherCount-(kHandSize-1)]) = cardAndCount.first;
+        ++otherCount;
+      }
+      state.setStartingCards(PlayerColor::kGreen, greenHand);
+      state.setStartingCards(PlayerColor::kRed, redHand);
+      state.setTurn(PlayerColor::kGreen);
+      for (const Action &action : state.getActions()) {
+        if (action.card != card || action.actionType == Action::ActionType::kDiscard) {
+          continue;
+        }
+        Sorry nextState = state;
+        nextState.doAction(action, nextState.getFaceDownCardCounts().front().first);
+        const auto nextSide = sideIndex(nextState.getPiecePositionsForPlayer(PlayerColor::kGreen));
+        if (!nextSide) {
+          // Backed out of the safe zone.
+          continue;
+        }
+        successors[side][cardIndex].emplace_back(*nextSide, nextState.getPlayerTurn() == PlayerColor::kGreen);
+      }
+    }
+  }
+
+  // Value iteration. A side of 0 has every piece home, so whoever has it has won.
+  std::vector<double> winProbabilities(kSideCount*kSideCount, 0.5);
+  for (int side=0; side<kSideCount; ++side) {
+    winProbabilities[side] = 1;
+    winProbabilities[side*kSideCount] = 0;
+  }
+  const auto valueOfTurn = [&](const std::vector<double> &values, int moverSide, int opponentSide) {
+    const auto at = [&](int mover, int opponent) { return values[mover*kSideCount + opponent]; };
+    // The best the mover can do with each card they might hold, best first, with how many of that card there are.
+    std::vector<std::pair<double, int>> cardValues;
+    for (size_t cardIndex=0; cardIndex<cardCounts.size(); ++cardIndex) {
+      const auto &cardSuccessors = successors[moverSide][cardIndex];
+      if (cardSuccessors.empty()) {
+        continue;
+      }
+      double best = 0;
+      for (const auto &[nextSide, goesAgain] : cardSuccessors) {
+        best = std::max(best, goesAgain ? at(nextSide, opponentSide) : 1-at(opponentSide, nextSide));
+      }
+      cardValues.emplace_back(best, cardCounts[cardIndex].second);
+    }
+    std::sort(cardValues.begin(), cardValues.end(), [](const auto &lhs, const auto &rhs) { return lhs.first > rhs.first; });
+    // The mover plays the best card in their hand, which is the first in `cardValues` that they hold. With none of them, they can only pass.
+    double value = 0;
+    int betterCardCount = 0;
+    double missingBetterProbability = 1;
+    for (const auto &[cardValue, count] : cardValues) {
+      betterCardCount += count;
+      const double missingProbability = probabilityOfMissing(betterCardCount, deckSize);
+      value += cardValue * (missingBetterProbability - missingProbability);
+      missingBetterProbability = missingProbability;
+    }
+    return value + missingBetterProbability * (1-at(opponentSide, moverSide));
+  };
+  ThreadPool pool(threadCount);
+  std::vector<double> nextWinProbabilities = winProbabilities;
+  bool converged = false;
+  for (int iteration=0; iteration<kMaxIterationCount && !converged; ++iteration) {
+    std::vector<std::future<double>> changes;
+    for (int moverSide=1; moverSide<kSideCount; ++moverSide) {
+      changes.push_back(pool.submit([&, moverSide]() {
+        double maxChange = 0;
+        for (int opponentSide=1; opponentSide<kSideCount; ++opponentSide) {
+          const double value = valueOfTurn(winProbabilities, moverSide, opponentSide);
+          maxChange = std::max(maxChange, std::abs(value - winProbabilities[moverSide*kSideCount + opponentSide]));
+          nextWinProbabilities[moverSide*kSideCount + opponentSide] = value;
+        }
+        return maxChange;
+      }));
+    }
+    double maxChange = 0;
+    for (auto &change : changes) {
+      maxChange = std::max(maxChange, change.get());
+    }
+    std::swap(winProbabilities, nextWinProbabilities);
+    converged = (maxChange < kConvergenceThreshold);
+  }
+  if (!converged) {
+    throw std::runtime_error("Race tablebase did not converge");
+  }
+
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Cannot open "+path);
+  }
+  output.write(kMagic, sizeof(kMagic)-1);
+  writeU32(output, kSideCount);
+  writeU32(output, 0);
+  for (double winProbability : winProbabilities) {
+    const float value = static_cast<float>(winProbability);
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32(output, bits);
+  }
+  output.flush();
+  if (!output) {
+    throw std::runtime_error("Failed writing "+path);
+  }
+}
+
+RaceTablebase::RaceTablebase(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open "+path);
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) != kFileSize) {
+    close(fd);
+    throw std::runtime_error(path+" is not a race tablebase");
+  }
+  const char *data;
+  void *mapping = mmap(nullptr, kFileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping != MAP_FAILED) {
+    mapping_ = mapping;
+    data = static_cast<const char*>(mapping);
+  } else {
+    // Some filesystems can't be mapped; the table is small enough to read instead.
+    buffer_ = std::make_unique<char[]>(kFileSize);
+    size_t readSize = 0;
+    while (readSize < kFileSize) {
+      const ssize_t result = pread(fd, buffer_.get()+readSize, kFileSize-readSize, readSize);
+      if (result <= 0) {
+        close(fd);
+        throw std::runtime_error("Failed reading "+path);
+      }
+      readSize += result;
+    }
+    data = buffer_.get();
+  }
+  close(fd);
+  if (std::memcmp(data, kMagic, sizeof(kMagic)-1) != 0 || readU32(data+sizeof(kMagic)-1) != kSideCount) {
+    if (mapping_ != nullptr) {
+      munmap(mapping_, kFileSize);
+    }
+    throw std::runtime_error(path+" is not a race tablebase");
+  }
+  if (hostIsLittleEndian()) {
+    winProbabilities_ = reinterpret_cast<const float*>(data+kHeaderSize);
+    return;
+  }
+  // The file is little-endian; other hosts need their own copy of the values.
+  decoded_ = std::make_unique<float[]>(kSideCount*kSideCount);
+  for (size_t i=0; i<kSideCount*kSideCount; ++i) {
+    const uint32_t bits = readU32(data+kHeaderSize+i*sizeof(float));
+    std::memcpy(&decoded_[i], &bits, sizeof(float));
+  }
+  winProbabilities_ = decoded_.get();
+}
+
+RaceTablebase::~RaceTablebase() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, kFileSize);
+  }
+}
+
+std::optional<std::array<float, 4>> RaceTablebase::probe(const Sorry &state) const {
+  // Check the mover first; it rules out most positions without building the player list.
+  const PlayerColor mover = state.getPlayerTurn();
+  const auto moverSide = sideIndex(state.getPiecePositionsForPlayer(mover));
+  if (!moverSide) {
+    return std::nullopt;
+  }
+  const auto players = state.getPlayers();
+  if (players.size() != 2) {
+    return std::nullopt;
+  }
+  const PlayerColor opponent = (players[0] == mover ? players[1] : players[0]);
+  const auto opponentSide = sideIndex(state.getPiecePositionsForPlayer(opponent));
+  if (!opponentSide) {
+    return std::nullopt;
+  }
+  const float moverWinProbability = winProbabilities_[*moverSide*kSideCount + *opponentSide];
+  std::array<float, 4> result{};
+  result[static_cast<int>(mover)] = moverWinProbability;
+  result[static_cast<int>(opponent)] = 1-moverWinProbability;
+  return result;
+}
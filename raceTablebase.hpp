@@ -0,0 +1,48 @@
+#ifndef RACE_TABLEBASE_HPP_
+#define RACE_TABLEBASE_HPP_
+
+#include "sorry.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+
+// Precomputed win probabilities of two-player races: games where every piece of both players is in its own safe zone or home, so that neither can affect the other any more.
+//
+// A player's side of a race is the set of safe zone squares they occupy, at most 4 of the 5, so there are 31 of them. The table holds, for every pair of sides, the probability that the player to move wins. It is computed by value iteration over a simplified game in which:
+//  - Every turn starts from a fresh hand, drawn from a full deck. In the real game, hands carry over and the deck runs down; tracking both would take around 10^11 entries.
+//  - A player never backs a piece out of the safe zone with a 4 or a 10. A card whose only moves would do that is treated as unplayable.
+// The player to move picks the move which maximizes their own win probability. Positions in the real game are looked up by where the pieces are, whatever the hands.
+//
+// The file starts with the 8 bytes "SRYRACE1", then a uint32 side count (31) and a uint32 0, then that many squared float32s: the mover's win probability by mover's side, then opponent's side. All numbers are little-endian. A side's index has bit d-1 set if a piece is d steps from home.
+class RaceTablebase {
+public:
+  // Maps the table at `path`, written by `generate`, into memory. On a big-endian host, the values are decoded into a copy instead.
+  explicit RaceTablebase(const std::string &path);
+  ~RaceTablebase();
+  RaceTablebase(const RaceTablebase&) = delete;
+  RaceTablebase& operator=(const RaceTablebase&) = delete;
+
+  // Computes the table, spread over `threadCount` threads, and writes it to `path`.
+  static void generate(const std::string &path, int threadCount);
+
+  // The probability of each player winning, by PlayerColor, or nullopt if `state` isn't a two-player race.
+  std::optional<std::array<float, 4>> probe(const sorry::Sorry &state) const;
+private:
+  static constexpr int kSideCount = 31;
+  static constexpr size_t kHeaderSize = 16;
+  static constexpr size_t kFileSize = kHeaderSize + kSideCount*kSideCount*sizeof(float);
+  // Either the mapped file, or a copy of it if it couldn't be mapped.
+  void *mapping_{nullptr};
+  std::unique_ptr<char[]> buffer_;
+  // The values in host byte order, if that isn't little-endian.
+  std::unique_ptr<float[]> decoded_;
+  const float *winProbabilities_{nullptr};
+
+  // The index of the side of a player with pieces at `positions`, or nullopt if any isn't in the safe zone or home.
+  static std::optional<int> sideIndex(const std::array<int, 4> &positions);
+};
+
+#endif // RACE_TABLEBASE_HPP_
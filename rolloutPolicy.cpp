@@ -0,0 +1,50 @@
+#include "heuristics.hpp"
+#include "rolloutPolicy.hpp"
+#include "sorry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+size_t UniformRolloutPolicy::chooseAction(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, std::mt19937 &eng) const {
+  std::uniform_int_distribution<size_t> dist(0, actions.size()-1);
+  return dist(eng);
+}
+
+HeuristicRolloutPolicy::HeuristicRolloutPolicy(double temperature, double epsilon) : temperature_(temperature), epsilon_(epsilon) {
+  if (temperature_ <= 0) {
+    throw std::runtime_error("Rollout temperature must be positive");
+  }
+  if (epsilon_ < 0 || epsilon_ > 1) {
+    throw std::runtime_error("Rollout epsilon must be in [0,1]");
+  }
+}
+
+size_t HeuristicRolloutPolicy::chooseAction(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, std::mt19937 &eng) const {
+  if (actions.size() == 1) {
+    return 0;
+  }
+  if (epsilon_ > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(eng) < epsilon_) {
+    std::uniform_int_distribution<size_t> dist(0, actions.size()-1);
+    return dist(eng);
+  }
+  // Reused across calls so that the weights do not need a fresh buffer at every step. Each step still allocates elsewhere: the caller's getActions() and the move list inside actionPrior().
+  thread_local std::vector<double> cumulativeWeights;
+  cumulativeWeights.resize(actions.size());
+  double maxPrior = -std::numeric_limits<double>::infinity();
+  for (size_t i=0; i<actions.size(); ++i) {
+    cumulativeWeights[i] = actionPrior(state, actions[i]);
+    maxPrior = std::max(maxPrior, cumulativeWeights[i]);
+  }
+  // Softmax, shifted by the largest prior so that exp() cannot overflow. Sampled by inverting the running sum of the weights rather than with std::discrete_distribution, which would allocate its own copy of them.
+  double totalWeight = 0;
+  for (double &weight : cumulativeWeights) {
+    totalWeight += std::exp((weight - maxPrior) / temperature_);
+    weight = totalWeight;
+  }
+  const double target = std::uniform_real_distribution<double>(0.0, totalWeight)(eng);
+  const auto chosen = std::upper_bound(cumulativeWeights.begin(), cumulativeWeights.end(), target);
+  // Rounding can put the target at the very end.
+  return std::min<size_t>(std::distance(cumulativeWeights.begin(), chosen), actions.size()-1);
+}
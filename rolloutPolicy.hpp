@@ -0,0 +1,37 @@
+#ifndef ROLLOUT_POLICY_HPP_
+#define ROLLOUT_POLICY_HPP_
+
+#include "action.hpp"
+
+#include <random>
+#include <vector>
+
+namespace sorry {
+class Sorry;
+} // namespace sorry
+
+// Decides which action to take at each step of a rollout. Implementations must be safe to call from several threads at once.
+class RolloutPolicy {
+public:
+  virtual ~RolloutPolicy() = default;
+  // Returns the index into `actions`, the legal actions of `state`, of the action to take. `actions` is never empty.
+  virtual size_t chooseAction(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, std::mt19937 &eng) const = 0;
+};
+
+// Every legal action is equally likely.
+class UniformRolloutPolicy : public RolloutPolicy {
+public:
+  size_t chooseAction(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, std::mt19937 &eng) const override;
+};
+
+// Plays like a greedy player: samples actions with probability proportional to exp(actionPrior / temperature), which favors reaching home, captures (the bigger the setback, the better), leaving start, and slides. With probability `epsilon`, picks uniformly instead so that rollouts still see unlikely lines.
+class HeuristicRolloutPolicy : public RolloutPolicy {
+public:
+  HeuristicRolloutPolicy(double temperature, double epsilon);
+  size_t chooseAction(const sorry::Sorry &state, const std::vector<sorry::Action> &actions, std::mt19937 &eng) const override;
+private:
+  const double temperature_;
+  const double epsilon_;
+};
+
+#endif // ROLLOUT_POLICY_HPP_
@@ -0,0 +1,121 @@
+#include "searchMultiplexer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+SearchMultiplexer::SearchMultiplexer(int threadCount, std::chrono::duration<double> sliceLength) : sliceLength_(sliceLength), pool_(threadCount) {
+  if (sliceLength <= std::chrono::duration<double>::zero()) {
+    throw std::runtime_error("Slice length must be positive");
+  }
+}
+
+SearchMultiplexer::~SearchMultiplexer() {
+  std::unique_lock lock(mutex_);
+  stopping_ = true;
+  for (auto it=searches_.begin(); it!=searches_.end();) {
+    // Running searches are finished by their worker at the end of the slice.
+    if (it->running || it->iterationCount == 0) {
+      ++it;
+      continue;
+    }
+    finish(*it);
+    it = searches_.erase(it);
+  }
+  // Searches without any iterations yet still get their one slice; the pool's destructor waits for the workers.
+}
+
+std::future<MultiplexedSearchResult> SearchMultiplexer::submit(SorryMcts &mcts, const sorry::Sorry &state, Clock::time_point deadline, double priority) {
+  if (priority <= 0) {
+    throw std::runtime_error("Priority must be positive");
+  }
+  std::future<MultiplexedSearchResult> result;
+  {
+    std::unique_lock lock(mutex_);
+    // Start level with the searches already running, so that neither the newcomer nor they get starved.
+    double minVirtualTime = std::numeric_limits<double>::infinity();
+    for (const Search &search : searches_) {
+      minVirtualTime = std::min(minVirtualTime, search.virtualTime);
+    }
+    Search &search = searches_.emplace_back(Search{&mcts, state, deadline, priority, {}});
+    search.virtualTime = (searches_.size() == 1 ? 0 : minVirtualTime);
+    result = search.result.get_future();
+    if (activeWorkerCount_ == pool_.threadCount()) {
+      return result;
+    }
+    ++activeWorkerCount_;
+  }
+  pool_.submit([this]() { workerLoop(); });
+  return result;
+}
+
+void SearchMultiplexer::workerLoop() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    auto it = nextSearch();
+    if (it == searches_.end()) {
+      // Nothing else to run; a later `submit` starts a new worker.
+      --activeWorkerCount_;
+      return;
+    }
+    Search &search = *it;
+    const Clock::time_point now = Clock::now();
+    if (search.iterationCount > 0 && (stopping_ || now >= search.deadline)) {
+      finish(search);
+      searches_.erase(it);
+      continue;
+    }
+    const auto sliceLength = std::max<std::chrono::duration<double>>(std::chrono::duration<double>::zero(), std::min<std::chrono::duration<double>>(sliceLength_, search.deadline - now));
+    search.running = true;
+    lock.unlock();
+    const Clock::time_point sliceStart = Clock::now();
+    try {
+      search.mcts->run(search.state, sliceLength);
+    } catch (...) {
+      lock.lock();
+      search.result.set_exception(std::current_exception());
+      searches_.erase(it);
+      continue;
+    }
+    const double sliceSeconds = std::chrono::duration<double>(Clock::now() - sliceStart).count();
+    lock.lock();
+    search.running = false;
+    // Each `run` of the same position keeps the whole tree but restarts the count.
+    search.iterationCount += search.mcts->getIterationCount();
+    // Slices run one after another on the same tree, so their times add up and the tree is as the last one left it.
+    const SearchStats sliceStats = search.mcts->getSearchStats();
+    const double wallSeconds = search.stats.wallSeconds + sliceStats.wallSeconds;
+    search.stats.merge(sliceStats);
+    search.stats.wallSeconds = wallSeconds;
+    search.stats.treeNodeCount = sliceStats.treeNodeCount;
+    search.stats.treeBytes = sliceStats.treeBytes;
+    search.virtualTime += sliceSeconds / search.priority;
+  }
+}
+
+std::list<SearchMultiplexer::Search>::iterator SearchMultiplexer::nextSearch() {
+  const Clock::time_point now = Clock::now();
+  auto best = searches_.end();
+  for (auto it=searches_.begin(); it!=searches_.end(); ++it) {
+    if (it->running) {
+      continue;
+    }
+    // Searches which are due go first, so that results aren't held up by other games' slices.
+    const bool due = (it->iterationCount > 0 && (stopping_ || now >= it->deadline));
+    if (due) {
+      return it;
+    }
+    if (best == searches_.end() || it->virtualTime < best->virtualTime) {
+      best = it;
+    }
+  }
+  return best;
+}
+
+void SearchMultiplexer::finish(Search &search) {
+  try {
+    search.result.set_value(MultiplexedSearchResult{search.mcts->pickBestAction(), search.mcts->getActionScores(), search.mcts->getWinRates(), search.iterationCount, search.stats});
+  } catch (...) {
+    search.result.set_exception(std::current_exception());
+  }
+}
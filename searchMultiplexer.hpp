@@ -0,0 +1,65 @@
+#ifndef SEARCH_MULTIPLEXER_HPP_
+#define SEARCH_MULTIPLEXER_HPP_
+
+#include "searchStats.hpp"
+#include "sorry.hpp"
+#include "sorryMcts.hpp"
+#include "threadPool.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
+#include <vector>
+
+struct MultiplexedSearchResult {
+  sorry::Action bestAction;
+  std::vector<ActionScore> actionScores;
+  std::vector<double> winRates;
+  int iterationCount;
+  // Of all the search's slices together.
+  SearchStats stats;
+};
+
+// Searches many independent games on one shared set of worker threads, instead of every game running its own search loop.
+//
+// Each search runs in short slices, one at a time, so that there are never more searches running than threads. Runnable searches share the threads in proportion to their priority. A search finishes at the first slice boundary after its deadline.
+class SearchMultiplexer {
+public:
+  using Clock = std::chrono::steady_clock;
+  explicit SearchMultiplexer(int threadCount, std::chrono::duration<double> sliceLength = std::chrono::milliseconds(5));
+  // Finishes every pending search right away with what it has so far.
+  ~SearchMultiplexer();
+  SearchMultiplexer(const SearchMultiplexer&) = delete;
+  SearchMultiplexer& operator=(const SearchMultiplexer&) = delete;
+
+  // Searches `state` with `mcts` until `deadline`. `mcts` must be single-threaded and must not be touched by anyone else until the result is ready. Since it is the caller's, its tree carries over to the next search of the same game. Every search gets at least one iteration, even if its deadline has already passed.
+  std::future<MultiplexedSearchResult> submit(SorryMcts &mcts, const sorry::Sorry &state, Clock::time_point deadline, double priority = 1.0);
+private:
+  struct Search {
+    SorryMcts *mcts;
+    sorry::Sorry state;
+    Clock::time_point deadline;
+    double priority;
+    std::promise<MultiplexedSearchResult> result;
+    int iterationCount{0};
+    SearchStats stats;
+    // Time searched so far divided by priority. The runnable search with the least goes next.
+    double virtualTime{0};
+    bool running{false};
+  };
+  const std::chrono::duration<double> sliceLength_;
+  std::mutex mutex_;
+  std::list<Search> searches_;
+  int activeWorkerCount_{0};
+  bool stopping_{false};
+  // Declared last so that its workers are joined before the state above is destroyed.
+  ThreadPool pool_;
+
+  void workerLoop();
+  std::list<Search>::iterator nextSearch();
+  static void finish(Search &search);
+};
+
+#endif // SEARCH_MULTIPLEXER_HPP_
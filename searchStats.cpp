@@ -0,0 +1,99 @@
+#include "searchStats.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+double SearchStats::iterationsPerSecond() const {
+  if (wallSeconds == 0) {
+    return 0;
+  }
+  return iterationCount / wallSeconds;
+}
+
+double SearchStats::averageDepth() const {
+  if (iterationCount == 0) {
+    return 0;
+  }
+  return static_cast<double>(totalDepth) / iterationCount;
+}
+
+double SearchStats::averageRolloutLength() const {
+  if (rolloutCount == 0) {
+    return 0;
+  }
+  return static_cast<double>(totalRolloutLength) / rolloutCount;
+}
+
+void SearchStats::addDepth(int depth) {
+  ++iterationCount;
+  totalDepth += depth;
+  maxDepth = std::max(maxDepth, depth);
+}
+
+void SearchStats::addRolloutLength(int plyCount) {
+  ++rolloutCount;
+  totalRolloutLength += plyCount;
+  ++rolloutLengthHistogram[std::min(plyCount / kRolloutLengthBucketWidth, kRolloutLengthBucketCount-1)];
+}
+
+void SearchStats::merge(const SearchStats &other) {
+  iterationCount += other.iterationCount;
+  wallSeconds = std::max(wallSeconds, other.wallSeconds);
+  nodesAllocated += other.nodesAllocated;
+  statisticsAllocated += other.statisticsAllocated;
+  nodesRecycled += other.nodesRecycled;
+  // Both describe the same tree.
+  treeNodeCount = std::max(treeNodeCount, other.treeNodeCount);
+  treeBytes = std::max(treeBytes, other.treeBytes);
+  peakTreeNodeCount = std::max(peakTreeNodeCount, other.peakTreeNodeCount);
+  maxDepth = std::max(maxDepth, other.maxDepth);
+  totalDepth += other.totalDepth;
+  rolloutCount += other.rolloutCount;
+  totalRolloutLength += other.totalRolloutLength;
+  for (size_t i=0; i<rolloutLengthHistogram.size(); ++i) {
+    rolloutLengthHistogram[i] += other.rolloutLengthHistogram[i];
+  }
+  endgameSolvedCount += other.endgameSolvedCount;
+  endgameUnsolvedCount += other.endgameUnsolvedCount;
+  selectionSeconds += other.selectionSeconds;
+  expansionSeconds += other.expansionSeconds;
+  rolloutSeconds += other.rolloutSeconds;
+  backpropSeconds += other.backpropSeconds;
+  lockWaitSeconds += other.lockWaitSeconds;
+}
+
+std::string SearchStats::toJson() const {
+  std::stringstream ss;
+  ss << '{';
+  ss << "\"iterations\":" << iterationCount << ',';
+  ss << "\"wall_seconds\":" << wallSeconds << ',';
+  ss << "\"iterations_per_second\":" << iterationsPerSecond() << ',';
+  ss << "\"nodes_allocated\":" << nodesAllocated << ',';
+  ss << "\"statistics_allocated\":" << statisticsAllocated << ',';
+  ss << "\"nodes_recycled\":" << nodesRecycled << ',';
+  ss << "\"tree_nodes\":" << treeNodeCount << ',';
+  ss << "\"tree_bytes\":" << treeBytes << ',';
+  ss << "\"peak_tree_nodes\":" << peakTreeNodeCount << ',';
+  ss << "\"max_depth\":" << maxDepth << ',';
+  ss << "\"average_depth\":" << averageDepth() << ',';
+  ss << "\"rollouts\":" << rolloutCount << ',';
+  ss << "\"average_rollout_length\":" << averageRolloutLength() << ',';
+  ss << "\"rollout_length_bucket_width\":" << kRolloutLengthBucketWidth << ',';
+  ss << "\"rollout_length_histogram\":[";
+  for (size_t i=0; i<rolloutLengthHistogram.size(); ++i) {
+    if (i != 0) {
+      ss << ',';
+    }
+    ss << rolloutLengthHistogram[i];
+  }
+  ss << "],";
+  ss << "\"endgame_solved\":" << endgameSolvedCount << ',';
+  ss << "\"endgame_unsolved\":" << endgameUnsolvedCount << ',';
+  ss << "\"selection_seconds\":" << selectionSeconds << ',';
+  ss << "\"expansion_seconds\":" << expansionSeconds << ',';
+  ss << "\"rollout_seconds\":" << rolloutSeconds << ',';
+  ss << "\"backprop_seconds\":" << backpropSeconds << ',';
+  ss << "\"lock_wait_seconds\":" << lockWaitSeconds;
+  ss << '}';
+  return ss.str();
+}
@@ -0,0 +1,58 @@
+#ifndef SEARCH_STATS_HPP_
+#define SEARCH_STATS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// What one search did and where its time went. Times of the individual phases are summed over all searching threads, so with several threads they add up to more than `wallSeconds`.
+struct SearchStats {
+  static constexpr int kRolloutLengthBucketWidth = 10;
+  // The last bucket also holds every longer rollout.
+  static constexpr int kRolloutLengthBucketCount = 32;
+
+  uint64_t iterationCount{0};
+  double wallSeconds{0};
+
+  // Allocated during this search, including nodes that were recycled again, so these can exceed the node budget. Statistics found in the transposition table are not counted.
+  uint64_t nodesAllocated{0};
+  uint64_t statisticsAllocated{0};
+  // Freed to stay within the node budget.
+  uint64_t nodesRecycled{0};
+  // The tree as the search left it: its nodes, and roughly how much memory they and the statistics they use take.
+  uint64_t treeNodeCount{0};
+  uint64_t treeBytes{0};
+  // Most nodes the tree held at any one time during this search.
+  uint64_t peakTreeNodeCount{0};
+
+  // Number of tree nodes that each iteration descended through before its rollouts.
+  int maxDepth{0};
+  uint64_t totalDepth{0};
+
+  uint64_t rolloutCount{0};
+  uint64_t totalRolloutLength{0};
+  // Rollouts by number of plies, in buckets of `kRolloutLengthBucketWidth`.
+  std::array<uint64_t, kRolloutLengthBucketCount> rolloutLengthHistogram{};
+
+  // Leaves which the endgame solver valued exactly instead of rolling out, and leaves it was tried on but couldn't solve.
+  uint64_t endgameSolvedCount{0};
+  uint64_t endgameUnsolvedCount{0};
+
+  double selectionSeconds{0};
+  double expansionSeconds{0};
+  double rolloutSeconds{0};
+  double backpropSeconds{0};
+  // Time spent waiting for locks which another thread held.
+  double lockWaitSeconds{0};
+
+  double iterationsPerSecond() const;
+  double averageDepth() const;
+  double averageRolloutLength() const;
+  void addDepth(int depth);
+  void addRolloutLength(int plyCount);
+  // Adds the counts and times of `other`, which searched at the same time as this.
+  void merge(const SearchStats &other);
+  std::string toJson() const;
+};
+
+#endif // SEARCH_STATS_HPP_
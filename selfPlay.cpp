@@ -0,0 +1,209 @@
+#include "common.hpp"
+#include "selfPlay.hpp"
+#include "sorry.hpp"
+#include "sorryMcts.hpp"
+#include "threadPool.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+constexpr char kMagic[] = "SRYSELF1";
+constexpr std::array<PlayerColor, 4> kColors = {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue, PlayerColor::kYellow};
+
+// Appends little-endian encodings to a byte buffer.
+class RecordBuffer {
+public:
+  void putU8(uint8_t value) {
+    bytes_.push_back(static_cast<char>(value));
+  }
+  void putU16(uint16_t value) {
+    putU8(value & 0xFF);
+    putU8(value >> 8);
+  }
+  void putU32(uint32_t value) {
+    putU16(value & 0xFFFF);
+    putU16(value >> 16);
+  }
+  void putF32(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putU32(bits);
+  }
+  const std::string& bytes() const {
+    return bytes_;
+  }
+private:
+  std::string bytes_;
+};
+
+// One move, until the winner is known.
+struct PendingRecord {
+  Sorry state;
+  std::vector<ActionScore> actionScores;
+  std::vector<double> winRates;
+};
+
+void encodeRecord(const PendingRecord &record, PlayerColor winner, RecordBuffer &buffer) {
+  const Sorry &state = record.state;
+  const auto players = state.getPlayers();
+  uint8_t playerMask = 0;
+  for (PlayerColor player : players) {
+    playerMask |= 1 << static_cast<int>(player);
+  }
+  buffer.putU8(static_cast<uint8_t>(state.getPlayerTurn()));
+  buffer.putU8(static_cast<uint8_t>(winner));
+  buffer.putU8(playerMask);
+  buffer.putU8(0);
+  for (PlayerColor color : kColors) {
+    const bool present = playerMask & (1 << static_cast<int>(color));
+    for (int position : (present ? state.getPiecePositionsForPlayer(color) : std::array<int, 4>{})) {
+      buffer.putU8(position);
+    }
+  }
+  for (PlayerColor color : kColors) {
+    const bool present = playerMask & (1 << static_cast<int>(color));
+    if (!present) {
+      for (int i=0; i<5; ++i) {
+        buffer.putU8(0);
+      }
+      continue;
+    }
+    for (Card card : state.getHandForPlayer(color)) {
+      buffer.putU8(static_cast<uint8_t>(card));
+    }
+  }
+  for (PlayerColor color : kColors) {
+    buffer.putF32(record.winRates.at(static_cast<int>(color)));
+  }
+  buffer.putU16(record.actionScores.size());
+  for (const ActionScore &actionScore : record.actionScores) {
+    buffer.putU32(actionScore.action.pack());
+    buffer.putU32(actionScore.visitCount);
+  }
+}
+
+// Plays game number `gameIndex` and returns its encoded records. If `statsLines` isn't null, appends a line of search statistics to it for every move.
+RecordBuffer playGame(const SelfPlayConfig &config, int gameIndex, ThreadPool &pool, uint64_t &positionCount, std::string *statsLines) {
+  std::mt19937 eng = createRandomEngine();
+  if (config.seed) {
+    eng.seed(hashCombine(*config.seed, gameIndex));
+  }
+  Sorry state(std::vector<PlayerColor>(kColors.begin(), kColors.begin()+config.playerCount));
+  state.drawRandomStartingCards(eng);
+  // Shared by every player, but reset before every search, so that no player searches with another's tree and every recorded search gets the same number of iterations.
+  SorryMcts mcts(config.explorationConstant);
+  mcts.setThreadCount(config.searchThreadCount);
+  mcts.setThreadPool(&pool);
+  mcts.setRaceTablebase(config.raceTablebase);
+  if (config.seed) {
+    mcts.setSeed(hashCombine(*config.seed, gameIndex));
+  }
+  std::vector<PendingRecord> records;
+  for (int moveIndex=0; !state.gameDone(); ++moveIndex) {
+    mcts.reset();
+    mcts.run(state, config.iterationsPerMove);
+    if (statsLines != nullptr) {
+      std::stringstream ss;
+      ss << "{\"game\":" << gameIndex << ",\"move\":" << moveIndex << ",\"color\":\"" << toString(state.getPlayerTurn()) << "\",\"stats\":" << mcts.getSearchStats().toJson() << "}\n";
+      *statsLines += ss.str();
+    }
+    PendingRecord record{state, mcts.getActionScores(), mcts.getWinRates()};
+    Action action = mcts.pickBestAction();
+    if (moveIndex < config.sampledMoveCount) {
+      std::vector<double> weights;
+      weights.reserve(record.actionScores.size());
+      for (const ActionScore &actionScore : record.actionScores) {
+        weights.push_back(actionScore.visitCount);
+      }
+      std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+      action = record.actionScores.at(dist(eng)).action;
+    }
+    records.push_back(std::move(record));
+    state.doAction(action, eng);
+  }
+  RecordBuffer buffer;
+  for (const PendingRecord &record : records) {
+    encodeRecord(record, state.getWinner(), buffer);
+  }
+  positionCount = records.size();
+  return buffer;
+}
+
+} // namespace
+
+double SelfPlayResult::positionsPerSecond() const {
+  if (wallSeconds == 0) {
+    return 0;
+  }
+  return positionCount / wallSeconds;
+}
+
+std::string SelfPlayResult::toString() const {
+  std::stringstream ss;
+  ss << gameCount << " games, " << positionCount << " positions in " << std::fixed << std::setprecision(1) << wallSeconds << "s (" << std::setprecision(2) << positionsPerSecond() << " positions/s)\n";
+  return ss.str();
+}
+
+SelfPlayResult runSelfPlay(const SelfPlayConfig &config) {
+  if (config.playerCount < 2 || config.playerCount > 4) {
+    throw std::runtime_error("Self-play needs 2 to 4 players");
+  }
+  if (config.threadCount < 1 || config.searchThreadCount < 1) {
+    throw std::runtime_error("Thread count must be at least 1");
+  }
+  std::ofstream output(config.outputPath, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Cannot open "+config.outputPath);
+  }
+  output.write(kMagic, sizeof(kMagic)-1);
+  std::ofstream statsOutput;
+  if (!config.statsPath.empty()) {
+    statsOutput.open(config.statsPath, std::ios::trunc);
+    if (!statsOutput) {
+      throw std::runtime_error("Cannot open "+config.statsPath);
+    }
+  }
+  const auto startTime = std::chrono::steady_clock::now();
+  SelfPlayResult result;
+  std::mutex outputMutex;
+  std::vector<std::future<void>> games;
+  games.reserve(config.gameCount);
+  {
+    ThreadPool pool(config.threadCount, config.pinThreads);
+    for (int gameIndex=0; gameIndex<config.gameCount; ++gameIndex) {
+      games.push_back(pool.submit([&, gameIndex]() {
+        uint64_t positionCount;
+        std::string statsLines;
+        const RecordBuffer buffer = playGame(config, gameIndex, pool, positionCount, statsOutput.is_open() ? &statsLines : nullptr);
+        // Whole games at a time, so that records from concurrent games don't interleave.
+        std::lock_guard guard(outputMutex);
+        output.write(buffer.bytes().data(), buffer.bytes().size());
+        statsOutput << statsLines;
+        result.positionCount += positionCount;
+        ++result.gameCount;
+      }));
+    }
+  }
+  for (auto &game : games) {
+    // Rethrows anything that went wrong in a game.
+    game.get();
+  }
+  output.flush();
+  if (!output) {
+    throw std::runtime_error("Failed writing "+config.outputPath);
+  }
+  result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  return result;
+}
@@ -0,0 +1,55 @@
+#ifndef SELF_PLAY_HPP_
+#define SELF_PLAY_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+class RaceTablebase;
+
+// Generates training data by letting MCTS play against itself.
+//
+// The output file starts with the 8 bytes "SRYSELF1", followed by one record per move until the end of the file. All numbers are little-endian. A record is:
+//   uint8   color of the player to move
+//   uint8   color of the player who went on to win the game
+//   uint8   bit mask of the colors in the game
+//   uint8   0
+//   uint8   [4][4] piece positions, by color, then by piece (0 for colors not in the game)
+//   uint8   [4][5] hands, by color, as Card values (0 for colors not in the game)
+//   float32 [4] the search's win rate estimate of each color
+//   uint16  number of actions searched
+//   that many of:
+//     uint32  packed action (see Action::pack)
+//     uint32  number of games played through the action
+struct SelfPlayConfig {
+  std::string outputPath;
+  int gameCount{100};
+  int threadCount{1};
+  // Threads each game's search uses. They share the games' pool, so this doesn't add threads.
+  int searchThreadCount{1};
+  bool pinThreads{false};
+  int playerCount{4};
+  int iterationsPerMove{1000};
+  double explorationConstant{2.0};
+  // The first this many moves of each game are sampled in proportion to their visit counts rather than picked greedily, so that games don't all repeat each other.
+  int sampledMoveCount{8};
+  // If not empty, the SearchStats of every move are written to this file, one JSON object per line: {"game":G,"move":M,"color":"Green","stats":{...}}. Lines of a game are written together with its records.
+  std::string statsPath;
+  // If not null, two-player games look up races in it. See SorryMcts::setRaceTablebase.
+  const RaceTablebase *raceTablebase{nullptr};
+  // If set, every game plays out the same way on every run with the same settings, though with several threads they may be written in a different order.
+  std::optional<uint64_t> seed;
+};
+
+struct SelfPlayResult {
+  int gameCount{0};
+  uint64_t positionCount{0};
+  double wallSeconds{0};
+  double positionsPerSecond() const;
+  std::string toString() const;
+};
+
+// Plays `config.gameCount` games on a pool of `config.threadCount` threads, appending each game's records to the output file as soon as it ends.
+SelfPlayResult runSelfPlay(const SelfPlayConfig &config);
+
+#endif // SELF_PLAY_HPP_
@@ -0,0 +1,59 @@
+#ifndef SEQ_LOCK_HPP_
+#define SEQ_LOCK_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Holds a value which one writer at a time publishes and any number of readers copy, without readers ever making the writer wait. A reader which overlaps with a write retries until it gets a consistent copy.
+template<typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>, "SeqLock copies its value word by word");
+public:
+  SeqLock() {
+    store(T{});
+  }
+  // Callers must make sure that only one thread stores at a time.
+  void store(const T &value) {
+    std::array<uint64_t, kWordCount> words{};
+    std::memcpy(words.data(), &value, sizeof(T));
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    // An odd sequence number tells readers that a write is in progress.
+    sequence_.store(sequence+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i=0; i<kWordCount; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence+2, std::memory_order_release);
+  }
+  T load() const {
+    std::array<uint64_t, kWordCount> words;
+    while (true) {
+      const uint64_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i=0; i<kWordCount; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(&value, words.data(), sizeof(T));
+    return value;
+  }
+private:
+  static constexpr size_t kWordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  std::atomic<uint64_t> sequence_{0};
+  // Atomic so that a read which overlaps with a write is not a data race; the sequence number is what makes the copy consistent.
+  std::array<std::atomic<uint64_t>, kWordCount> words_;
+};
+
+#endif // SEQ_LOCK_HPP_
@@ -1,3 +1,4 @@
+#include "common.hpp"
 #include "sorry.hpp"
 
 #include <algorithm>
@@ -69,16 +70,8 @@ void Sorry::setStartingCards(PlayerColor playerColor, const std::array<Card,5> &
     deck_.removeSpecificCard(cards[i]);
   }
 
-  static std::vector<bool> haveStartingHandForPlayer(players_.size(), false);
-  auto it = std::find_if(players_.begin(), players_.end(), [&](const auto &p) {
-    return p.playerColor == playerColor;
-  });
-  if (it == players_.end()) {
-    throw std::runtime_error("Dont have player");
-  }
-  int index = std::distance(players_.begin(), it);
-  haveStartingHandForPlayer[index] = true;
-  haveStartingHands_ = std::all_of(haveStartingHandForPlayer.begin(), haveStartingHandForPlayer.end(), [](bool b) { return b; });
+  player.hasStartingHand = true;
+  haveStartingHands_ = std::all_of(players_.begin(), players_.end(), [](const Player &p) { return p.hasStartingHand; });
 }
 
 void Sorry::setStartingPositions(PlayerColor playerColor, const std::array<int, 4> &positions) {
@@ -98,6 +91,28 @@ void Sorry::setTurn(PlayerColor playerColor) {
   }
 }
 
+void Sorry::randomizeHiddenInformation(PlayerColor playerColor, std::mt19937 &eng) {
+  // Opponents' hands are drawn from the same unseen pool as the face-down deck, so shuffle them back in first.
+  for (const Player &player : players_) {
+    if (player.playerColor == playerColor) {
+      continue;
+    }
+    for (Card card : player.hand) {
+      deck_.returnCard(card);
+    }
+  }
+  // Otherwise where the returned cards landed would let the real hidden hands steer the deal.
+  deck_.sortFaceDown();
+  for (Player &player : players_) {
+    if (player.playerColor == playerColor) {
+      continue;
+    }
+    for (Card &card : player.hand) {
+      card = deck_.drawRandomCard(eng);
+    }
+  }
+}
+
 std::string Sorry::toString() const {
   if (!haveStartingHands_) {
     throw std::runtime_error("Called toString() without starting hands set");
@@ -220,17 +235,44 @@ std::vector<Sorry::Move> Sorry::getMovesForAction(const Action &action) const {
     throw std::runtime_error("No piece in start");
   };
   std::vector<Move> result;
+  auto addOurMoveAndBumps = [&](int pieceIndex, int moveDestination) {
+    result.push_back(Move{.playerColor = action.playerColor,
+                          .pieceIndex = pieceIndex,
+                          .srcPosition = posOfPlayerPiece(action.playerColor, pieceIndex),
+                          .destPosition = posAfterSlide(action.playerColor, moveDestination)});
+    // Same as in doAction(); opponents on the landing spot or anywhere along the slide go back to start.
+    const int slideLength = std::max(1, slideLengthAtPos(action.playerColor, moveDestination));
+    for (int i=0; i<slideLength; ++i) {
+      const int pos = posAfterMoveForPlayer(action.playerColor, moveDestination, i);
+      if (pos == 0 || pos > 60) {
+        continue;
+      }
+      for (const auto &player : players_) {
+        if (player.playerColor == action.playerColor) {
+          continue;
+        }
+        for (size_t j=0; j<player.piecePositions.size(); ++j) {
+          if (player.piecePositions.at(j) != pos) {
+            continue;
+          }
+          const bool alreadyBumped = std::any_of(result.begin(), result.end(), [&](const Move &move) {
+            return move.playerColor == player.playerColor && move.pieceIndex == static_cast<int>(j);
+          });
+          if (!alreadyBumped) {
+            result.push_back(Move{.playerColor = player.playerColor,
+                                  .pieceIndex = static_cast<int>(j),
+                                  .srcPosition = pos,
+                                  .destPosition = 0});
+          }
+        }
+      }
+    }
+  };
   if (action.actionType == Action::ActionType::kSingleMove ||
       action.actionType == Action::ActionType::kDoubleMove) {
-    result.push_back(Move{.playerColor = action.playerColor,
-                          .pieceIndex = action.piece1Index,
-                          .srcPosition = posOfPlayerPiece(action.playerColor, action.piece1Index),
-                          .destPosition = action.move1Destination});
+    addOurMoveAndBumps(action.piece1Index, action.move1Destination);
     if (action.actionType == Action::ActionType::kDoubleMove) {
-      result.push_back(Move{.playerColor = action.playerColor,
-                            .pieceIndex = action.piece2Index,
-                            .srcPosition = posOfPlayerPiece(action.playerColor, action.piece2Index),
-                            .destPosition = action.move2Destination});
+      addOurMoveAndBumps(action.piece2Index, action.move2Destination);
     }
   } else if (action.actionType == Action::ActionType::kSwap) {
     const auto startPos = posOfPlayerPiece(action.playerColor, action.piece1Index);
@@ -259,7 +301,28 @@ std::vector<Sorry::Move> Sorry::getMovesForAction(const Action &action) const {
 }
 
 void Sorry::doAction(const Action &action, std::mt19937 &eng) {
-  const auto prevState = *this;
+  moveForAction(action);
+  // Draw before discarding, so that the played card can't be drawn right back.
+  finishTurn(action, deck_.drawRandomCard(eng));
+}
+
+void Sorry::doAction(const Action &action, Card drawnCard) {
+  moveForAction(action);
+  deck_.removeSpecificCard(drawnCard);
+  finishTurn(action, drawnCard);
+}
+
+std::vector<std::pair<Card, int>> Sorry::getFaceDownCardCounts() const {
+  return deck_.faceDownCardCounts();
+}
+
+void Sorry::moveForAction(const Action &action) {
+  constexpr bool kRunSanityCheck{false};
+  // Only copied when checking, since doAction is on the hot path of every rollout.
+  std::optional<Sorry> prevState;
+  if constexpr (kRunSanityCheck) {
+    prevState = *this;
+  }
   if (!haveStartingHands_) {
     throw std::runtime_error("Called doAction() without a starting hand set");
   }
@@ -354,7 +417,6 @@ void Sorry::doAction(const Action &action, std::mt19937 &eng) {
   }
 
   // Do a quick sanity check to make that no two pieces are in the same spot, apart from start and home.
-  constexpr bool kRunSanityCheck{false};
   if constexpr (kRunSanityCheck) {
     std::set<int> publicPositionsWithPiece;
     for (const Player &player : players_) {
@@ -362,7 +424,7 @@ void Sorry::doAction(const Action &action, std::mt19937 &eng) {
 
         if (pos > 0 && pos < 61) {
           if (publicPositionsWithPiece.find(pos) != publicPositionsWithPiece.end()) {
-            std::cout << " -  Previous state: " << prevState.toString() << std::endl;
+            std::cout << " -  Previous state: " << prevState->toString() << std::endl;
             std::cout << " -  Applied action: " << action.toString() << std::endl;
             std::cout << " -  Result state: " << toString() << std::endl;
             throw std::runtime_error("Multiple pieces on position "+std::to_string(pos));
@@ -373,8 +435,11 @@ void Sorry::doAction(const Action &action, std::mt19937 &eng) {
     }
   }
 
-  // Draw/discard.
-  Card newCard = deck_.drawRandomCard(eng);
+}
+
+void Sorry::finishTurn(const Action &action, Card newCard) {
+  Player &player = getPlayer(action.playerColor);
+  // Discard, and shuffle if the deck ran out.
   if (SorryRules::instance().shuffleAfterDiscard) {
     deck_.discard(action.card);
     if (deck_.empty()) {
@@ -424,6 +489,43 @@ PlayerColor Sorry::getWinner() const {
   return *winner;
 }
 
+uint64_t Sorry::hash() const {
+  uint64_t result = hashCombine(deck_.hash(), currentPlayerIndex_);
+  for (const Player &player : players_) {
+    // Positions are at most 66, so each fits in 7 bits.
+    uint64_t positions = static_cast<uint64_t>(player.playerColor);
+    for (int pos : player.piecePositions) {
+      positions = (positions << 7) | pos;
+    }
+    // A hand holds at most 5 of a card, so each count fits in 3 bits.
+    uint64_t cardCounts = 0;
+    for (Card card : player.hand) {
+      cardCounts += 1ull << (3*static_cast<int>(card));
+    }
+    result = hashCombine(hashCombine(result, positions), cardCounts);
+  }
+  return result;
+}
+
+uint64_t Sorry::informationSetHash(PlayerColor playerColor) const {
+  uint64_t result = hashCombine(hashCombine(deck_.publicHash(), currentPlayerIndex_), static_cast<uint64_t>(playerColor));
+  for (const Player &player : players_) {
+    uint64_t positions = static_cast<uint64_t>(player.playerColor);
+    for (int pos : player.piecePositions) {
+      positions = (positions << 7) | pos;
+    }
+    result = hashCombine(result, positions);
+    if (player.playerColor == playerColor) {
+      uint64_t cardCounts = 0;
+      for (Card card : player.hand) {
+        cardCounts += 1ull << (3*static_cast<int>(card));
+      }
+      result = hashCombine(result, cardCounts);
+    }
+  }
+  return result;
+}
+
 int Sorry::getFirstPosition(PlayerColor playerColor) const {
   // Different color players come out of start to different positions.
   if (playerColor == PlayerColor::kGreen) {
@@ -550,25 +652,40 @@ void Sorry::addActionsForCard(const Player &player, Card card, std::vector<Actio
   }
 }
 
+int Sorry::getLastPublicPosition(PlayerColor playerColor) const {
+  //  Green goes from 60 to 61
+  //    Red goes from 15 to 61
+  //   Blue goes from 30 to 61
+  // Yellow goes from 45 to 61
+  if (playerColor == PlayerColor::kGreen) {
+    return 60;
+  } else if (playerColor == PlayerColor::kRed) {
+    return 15;
+  } else if (playerColor == PlayerColor::kBlue) {
+    return 30;
+  } else if (playerColor == PlayerColor::kYellow) {
+    return 45;
+  } else {
+    throw std::runtime_error("Invalid player");
+  }
+}
+
+int Sorry::distanceToHome(PlayerColor playerColor, int position) const {
+  if (position == 0) {
+    // One move out of start, then the rest of the way from the first position.
+    return 1 + distanceToHome(playerColor, getFirstPosition(playerColor));
+  }
+  if (position > 60) {
+    // Safe zone or home.
+    return 66 - position;
+  }
+  // Around the board to the last public position, then one step into the safe zone and five more to home.
+  return (getLastPublicPosition(playerColor) - position + 60) % 60 + 6;
+}
+
 int Sorry::posAfterMoveForPlayer(PlayerColor playerColor, int startingPosition, int moveDistance) const {
   int newPosition = startingPosition + moveDistance;
-  const int lastPublicPos = [&]() {
-    //  Green goes from 60 to 61
-    //    Red goes from 15 to 61
-    //   Blue goes from 30 to 61
-    // Yellow goes from 45 to 61
-    if (playerColor == PlayerColor::kGreen) {
-      return 60;
-    } else if (playerColor == PlayerColor::kRed) {
-      return 15;
-    } else if (playerColor == PlayerColor::kBlue) {
-      return 30;
-    } else if (playerColor == PlayerColor::kYellow) {
-      return 45;
-    } else {
-      throw std::runtime_error("Invalid player");
-    }
-  }();
+  const int lastPublicPos = getLastPublicPosition(playerColor);
   bool inSafeZone{false};
   if (startingPosition <= lastPublicPos && newPosition > lastPublicPos) {
     // Moving forward into the safe zone
@@ -40,6 +40,8 @@ public:
   void setStartingCards(PlayerColor playerColor, const std::array<Card,5> &cards);
   void setStartingPositions(PlayerColor playerColor, const std::array<int, 4> &positions);
   void setTurn(PlayerColor playerColor);
+  // Replaces every hand but `playerColor`'s with cards drawn at random from the cards `playerColor` cannot see.
+  void randomizeHiddenInformation(PlayerColor playerColor, std::mt19937 &eng);
 
   std::string toString() const;
   std::string handToString() const;
@@ -56,19 +58,33 @@ public:
     int srcPosition;
     int destPosition;
   };
+  // Every piece which `action` would move, including where slides end and opponents which get sent back to start.
   std::vector<Move> getMovesForAction(const Action &action) const;
 
+  // Number of single steps `playerColor` needs to take a piece from `position` to home. Start counts as one step before the first position.
+  int distanceToHome(PlayerColor playerColor, int position) const;
+
   void doAction(const Action &action, std::mt19937 &eng);
+  // Like the above, but the player draws `drawnCard`, which must be face down in the deck. For enumerating every possible draw.
+  void doAction(const Action &action, Card drawnCard);
+  // How many of each card are face down in the deck, and so could be drawn next. Only cards with a count are listed.
+  std::vector<std::pair<Card, int>> getFaceDownCardCounts() const;
 
   bool gameDone() const;
   PlayerColor getWinner() const;
 
+  // A key for this position. Positions which only differ in the order of the deck or of a hand get the same key, since they play identically.
+  uint64_t hash() const;
+  // A key for what `playerColor` knows about this position. Positions which only differ in cards hidden from `playerColor` get the same key.
+  uint64_t informationSetHash(PlayerColor playerColor) const;
+
 private:
   Sorry(const PlayerColor *playerColors, size_t playerCount);
   struct Player {
     PlayerColor playerColor;
     std::array<Card,5> hand;
     std::array<int, 4> piecePositions;
+    bool hasStartingHand{false};
     size_t indexOfCardInHand(Card card) const;
     std::string toString() const;
   };
@@ -76,6 +92,9 @@ private:
   bool haveStartingHands_{false};
   int currentPlayerIndex_;
   Deck deck_;
+  // The two halves of doAction: moving pieces, then replacing the card and passing the turn.
+  void moveForAction(const Action &action);
+  void finishTurn(const Action &action, Card newCard);
   void addActionsForCard(const Player &player, Card card, std::vector<Action> &actions) const;
   std::optional<int> getMoveResultingPos(const Player &player, int pieceIndex, int moveDistance) const;
   std::optional<std::pair<int,int>> getDoubleMoveResultingPos(const Player &player, int piece1Index, int move1Distance, int piece2Index, int move2Distance) const;
@@ -88,6 +107,7 @@ private:
   const Player& getPlayer(PlayerColor player) const;
   int posAfterMoveForPlayer(PlayerColor playerColor, int startingPosition, int moveDistance) const;
   int getFirstPosition(PlayerColor playerColor) const;
+  int getLastPublicPosition(PlayerColor playerColor) const;
   static bool playerIsDone(const Player &player);
 
   friend bool operator==(const Sorry &lhs, const Sorry &rhs);
@@ -1,24 +1,68 @@
 #include "common.hpp"
+#include "endgameSolver.hpp"
+#include "heuristics.hpp"
+#include "raceTablebase.hpp"
+#include "rolloutPolicy.hpp"
+#include "searchStats.hpp"
+#include "seqLock.hpp"
 #include "sorry.hpp"
 #include "sorryMcts.hpp"
+#include "spinLock.hpp"
+#include "threadPool.hpp"
+#include "transpositionTable.hpp"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <numeric>
+#include <shared_mutex>
 #include <thread>
+#include <tuple>
+#include <unordered_set>
 
 class TimeLoopCondition : public internal::LoopCondition {
 public:
-  TimeLoopCondition(std::chrono::duration<double> timeLimit) : startTime_(std::chrono::high_resolution_clock::now()), timeLimit_(timeLimit) {}
+  TimeLoopCondition(std::chrono::duration<double> timeLimit) : startTime_(std::chrono::steady_clock::now()), timeLimit_(timeLimit) {}
   bool condition() const override {
-    return std::chrono::high_resolution_clock::now() < startTime_+timeLimit_;
+    // Reading the clock costs about as much as a few tree steps, so only do it every few calls. Overshooting by that many iterations is negligible next to a rollout.
+    if (completedCount_ == 0) {
+      // However short the limit, always search at least once, so that there is an action to pick.
+      return true;
+    }
+    if (expired_) {
+      return false;
+    }
+    if (callCount_.fetch_add(1, std::memory_order_relaxed) % kCallsPerClockCheck == 0) {
+      if (std::chrono::steady_clock::now() >= startTime_+timeLimit_) {
+        expired_ = true;
+        return false;
+      }
+    }
+    return true;
+  }
+  void oneIterationComplete() override {
+    ++completedCount_;
+  }
+  std::optional<int> remainingIterations() const override {
+    // Assume the rest of the time goes as fast as the time so far.
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime_;
+    if (elapsed.count() <= 0) {
+      return std::nullopt;
+    }
+    const double remainingSeconds = std::max(0.0, (timeLimit_ - elapsed).count());
+    return static_cast<int>(completedCount_ * remainingSeconds / elapsed.count());
   }
-  void oneIterationComplete() override {}
 private:
-  const std::chrono::high_resolution_clock::time_point startTime_;
+  static constexpr int kCallsPerClockCheck = 16;
+  const std::chrono::steady_clock::time_point startTime_;
   const std::chrono::duration<double> timeLimit_;
+  mutable std::atomic<int> callCount_{0};
+  mutable std::atomic<bool> expired_{false};
+  std::atomic<int> completedCount_{0};
 };
 
 class CountCondition : public internal::LoopCondition {
@@ -27,12 +71,20 @@ public:
   bool condition() const override {
     return current_ < count_;
   }
+  bool claimIteration() override {
+    return claimed_.fetch_add(1) < count_;
+  }
   void oneIterationComplete() override {
     ++current_;
   }
+  std::optional<int> remainingIterations() const override {
+    return std::max(0, count_ - current_);
+  }
 private:
   const int count_;
-  int current_{0};
+  std::atomic<int> current_{0};
+  // Iterations handed out, including ones still running. Goes past `count_` once each thread has been told to stop.
+  std::atomic<int> claimed_{0};
 };
 
 void ExplicitTerminator::setDone(bool done) {
@@ -45,33 +97,313 @@ bool ExplicitTerminator::condition() const {
 
 void ExplicitTerminator::oneIterationComplete() {}
 
+DeadlineCondition::DeadlineCondition(std::chrono::steady_clock::time_point deadline) : deadline_(deadline.time_since_epoch().count()) {}
+
+void DeadlineCondition::setDeadline(std::chrono::steady_clock::time_point deadline) {
+  deadline_ = deadline.time_since_epoch().count();
+}
+
+void DeadlineCondition::stop() {
+  stopped_ = true;
+}
+
+bool DeadlineCondition::condition() const {
+  if (completedCount_ == 0) {
+    return true;
+  }
+  if (stopped_) {
+    return false;
+  }
+  // As in TimeLoopCondition, only read the clock every few calls. The deadline itself is checked every time, so moving it takes effect at once.
+  if (callCount_.fetch_add(1, std::memory_order_relaxed) % kCallsPerClockCheck == 0) {
+    now_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  }
+  return now_.load(std::memory_order_relaxed) < deadline_.load(std::memory_order_relaxed);
+}
+
+void DeadlineCondition::oneIterationComplete() {
+  ++completedCount_;
+}
+
 using namespace sorry;
 
-struct Node {
-  explicit Node(const Sorry &s) : state(s) {}
-  Node(const Sorry &s, const Action &a, Node *p) : state(s), action(a), parent(p) {}
-  ~Node() {
-    for (Node *successor : successors) {
-      delete successor;
+// What has been learned about a position in which `playerTurn` has to pick one of `actions`. May be shared by all nodes with the same position through the transposition table.
+struct NodeStatistics {
+  NodeStatistics(const Sorry &state, bool orderByPrior) : playerTurn(state.getPlayerTurn()) {
+    auto legalActions = state.getActions();
+    if (orderByPrior) {
+      // Most promising first, since that is the order in which they are expanded.
+      std::vector<std::pair<double, size_t>> priorAndIndex;
+      priorAndIndex.reserve(legalActions.size());
+      for (size_t i=0; i<legalActions.size(); ++i) {
+        priorAndIndex.emplace_back(-actionPrior(state, legalActions[i]), i);
+      }
+      std::sort(priorAndIndex.begin(), priorAndIndex.end());
+      actions.reserve(legalActions.size());
+      for (const auto &[prior, index] : priorAndIndex) {
+        actions.push_back(legalActions[index].pack());
+      }
+    } else {
+      actions.reserve(legalActions.size());
+      for (const Action &action : legalActions) {
+        actions.push_back(action.pack());
+      }
+    }
+    gameCounts.resize(actions.size());
+    virtualLosses.resize(actions.size());
+    for (auto &winCountsOfPlayer : winCounts) {
+      winCountsOfPlayer.resize(actions.size());
+    }
+    availabilityCounts.resize(actions.size());
+    raveGameCounts.resize(actions.size());
+    raveWinCounts.resize(actions.size());
+  }
+  const PlayerColor playerTurn;
+
+  // Guards everything below. Critical sections are a single pass over the actions at most.
+  mutable SpinLock lock;
+
+  // Legal actions, generated once when the statistics are created. In information set search, the actions of an opponent depend on their hidden hand, so this grows as other determinizations reveal other actions.
+  std::vector<uint32_t> actions;
+
+  // Actions before `expandedCount` have been tried at least once; the rest are tried in order, either before any selection happens or, with progressive widening, as the visit count grows.
+  size_t expandedCount{0};
+
+  // Per-action statistics, kept as one contiguous array per field so that all actions can be scored in a single vectorized pass.
+  std::vector<float> gameCounts;
+  // Number of threads currently searching beneath each action. Each one counts as a lost game until it backprops, which steers concurrent descents apart.
+  std::vector<float> virtualLosses;
+  // Indexed by player, then by action.
+  std::array<std::vector<float>, 4> winCounts;
+  // Information set search only: number of visits in which each action was legal.
+  std::vector<float> availabilityCounts;
+  // RAVE only: number of games in which the player to move took each action at this point or anywhere later, and how many of those they won.
+  std::vector<float> raveGameCounts;
+  std::vector<float> raveWinCounts;
+
+  // Totals of all games played through this position.
+  std::array<float, 4> totalWinCounts{};
+  float totalGameCount{0};
+
+  size_t expandedActionCount() const {
+    return std::min(expandedCount, actions.size());
+  }
+  // Returns the index of `action`, appending it if it's new.
+  size_t indexOf(uint32_t action) {
+    auto it = std::find(actions.begin(), actions.end(), action);
+    if (it != actions.end()) {
+      return std::distance(actions.begin(), it);
+    }
+    actions.push_back(action);
+    gameCounts.push_back(0);
+    virtualLosses.push_back(0);
+    for (auto &winCountsOfPlayer : winCounts) {
+      winCountsOfPlayer.push_back(0);
     }
+    availabilityCounts.resize(actions.size());
+    raveGameCounts.resize(actions.size());
+    raveWinCounts.resize(actions.size());
+    return actions.size()-1;
   }
+  float gameCount() const {
+    std::lock_guard guard(lock);
+    return totalGameCount;
+  }
+  // Rough memory footprint of statistics with `actionCount` actions.
+  static constexpr size_t estimatedBytes(size_t actionCount) {
+    return sizeof(NodeStatistics) + actionCount * (sizeof(uint32_t) + 9*sizeof(float));
+  }
+};
+
+// The outcome of one rollout.
+struct Playout {
+  // Share of the win credited to each player. One-hot if the game was played to the end, otherwise the evaluator's estimate.
+  std::array<float, 4> wins{};
+  int plyCount{0};
+  // RAVE only: every action taken during the rollout, sorted.
+  std::vector<uint32_t> actions;
+};
+
+// Where one descent from the root ended up, waiting for its rollouts.
+struct Descent {
   Sorry state;
-  Action action;
-  Node *parent{nullptr};
-  std::vector<Node*> successors;
-  std::array<int, 4> winCount = {0,0,0,0};
-  int gameCount{0}; // TODO: Maybe can be removed
+  // Every (node statistics, action index) that the descent went through.
+  std::vector<std::pair<NodeStatistics*, size_t>> path;
+};
+
+namespace {
 
-  double score() const {
-    if (gameCount == 0) {
-      throw std::runtime_error("Cannot get score of node with no games");
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Locks `lockable`, adding to `stats` how long that took if another thread held it.
+template<typename Lockable>
+std::unique_lock<Lockable> lockCountingWait(Lockable &lockable, SearchStats &stats) {
+  std::unique_lock<Lockable> lock(lockable, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    const auto start = Clock::now();
+    lock.lock();
+    stats.lockWaitSeconds += secondsSince(start);
+  }
+  return lock;
+}
+
+} // namespace
+
+// One occurrence of a position in the tree.
+struct Node {
+  Node(uint64_t k, std::shared_ptr<NodeStatistics> s) : key(k), statistics(std::move(s)) {}
+  ~Node() {
+    for (const auto &successorsOfAction : successors) {
+      for (Node *successor : successorsOfAction) {
+        delete successor;
+      }
     }
-    return winCount.at(static_cast<int>(action.playerColor)) / static_cast<double>(gameCount);
   }
+  const uint64_t key;
+  const std::shared_ptr<NodeStatistics> statistics;
+
+  // Guards `successors`. Held only while finding/creating a successor, never during a rollout.
+  std::mutex successorsMutex;
+  // For each action, the positions which have followed it so far. Which position follows an action depends on the card drawn. Grown on demand.
+  std::vector<std::vector<Node*>> successors;
 };
 
-SorryMcts::SorryMcts(double explorationConstant) : explorationConstant_(explorationConstant) {
-  eng_ = createRandomEngine();
+namespace {
+
+const UniformRolloutPolicy kUniformRolloutPolicy;
+
+} // namespace
+
+// What readers see of the root, published by the search every so often. Trivial so that SeqLock can copy it; value-initialize it to zero it.
+struct RootSnapshot {
+  // Roots with more tried actions than this only publish the first ones; no position seen in practice comes close.
+  static constexpr size_t kMaxActionCount = 256;
+  uint32_t actionCount;
+  std::array<uint32_t, kMaxActionCount> actions;
+  std::array<float, kMaxActionCount> scores;
+  std::array<float, kMaxActionCount> gameCounts;
+  std::array<float, 4> totalWinCounts;
+};
+
+namespace {
+
+size_t subtreeSize(const Node *node) {
+  size_t result = 1;
+  for (const auto &successorsOfAction : node->successors) {
+    for (const Node *successor : successorsOfAction) {
+      result += subtreeSize(successor);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+SorryMcts::SorryMcts(double explorationConstant) : explorationConstant_(explorationConstant), rolloutPolicy_(&kUniformRolloutPolicy), rootSnapshot_(std::make_unique<SeqLock<RootSnapshot>>()) {}
+
+SorryMcts::~SorryMcts() {
+  reset();
+}
+
+void SorryMcts::setThreadCount(int threadCount) {
+  if (threadCount < 1) {
+    throw std::runtime_error("Thread count must be at least 1");
+  }
+  threadCount_ = threadCount;
+}
+
+void SorryMcts::setInformationSetSearch(bool enabled) {
+  if (enabled != informationSetSearch_ && transpositionTable_) {
+    // Keys of the two modes mean different things.
+    transpositionTable_->clear();
+  }
+  informationSetSearch_ = enabled;
+}
+
+void SorryMcts::setTranspositionTableSize(size_t maxBytes) {
+  if (maxBytes == 0) {
+    transpositionTable_.reset();
+    return;
+  }
+  // Estimate an entry by a position with a typical number of actions.
+  constexpr size_t kTypicalActionCount = 12;
+  constexpr size_t kBytesPerEntry = sizeof(uint64_t) + sizeof(std::shared_ptr<NodeStatistics>) + NodeStatistics::estimatedBytes(kTypicalActionCount);
+  transpositionTable_ = std::make_unique<TranspositionTable<NodeStatistics>>(maxBytes / kBytesPerEntry);
+}
+
+void SorryMcts::setProgressiveWidening(double coefficient, double exponent) {
+  if (coefficient < 0 || exponent < 0 || exponent > 1) {
+    throw std::runtime_error("Invalid progressive widening parameters");
+  }
+  if ((coefficient > 0) != (progressiveWideningCoefficient_ > 0) && transpositionTable_) {
+    // Stored statistics have their actions in the other order.
+    transpositionTable_->clear();
+  }
+  progressiveWideningCoefficient_ = coefficient;
+  progressiveWideningExponent_ = exponent;
+}
+
+void SorryMcts::setRolloutDepthLimit(int plyCount) {
+  if (plyCount < 0) {
+    throw std::runtime_error("Rollout depth limit must not be negative");
+  }
+  rolloutDepthLimit_ = plyCount;
+}
+
+void SorryMcts::setEndgameSolver(int maxPiecesOutsideHome, int maxDistanceToHome, size_t nodeBudget) {
+  if (maxPiecesOutsideHome == 0) {
+    endgameSolver_.reset();
+    return;
+  }
+  endgameSolver_ = std::make_unique<EndgameSolver>(maxPiecesOutsideHome, maxDistanceToHome, nodeBudget);
+}
+
+void SorryMcts::setRaceTablebase(const RaceTablebase *raceTablebase) {
+  raceTablebase_ = raceTablebase;
+}
+
+void SorryMcts::setRolloutPolicy(const RolloutPolicy *rolloutPolicy) {
+  rolloutPolicy_ = (rolloutPolicy != nullptr ? rolloutPolicy : &kUniformRolloutPolicy);
+}
+
+void SorryMcts::setRave(double equivalenceParameter) {
+  if (equivalenceParameter < 0) {
+    throw std::runtime_error("RAVE equivalence parameter must not be negative");
+  }
+  raveEquivalenceParameter_ = equivalenceParameter;
+}
+
+void SorryMcts::setNodeBudget(size_t maxNodeCount, NodeBudgetPolicy policy) {
+  nodeBudget_ = maxNodeCount;
+  nodeBudgetPolicy_ = policy;
+}
+
+void SorryMcts::setEarlyStopping(bool enabled) {
+  earlyStopping_ = enabled;
+}
+
+void SorryMcts::setSeed(std::optional<uint64_t> seed) {
+  seed_ = seed;
+}
+
+void SorryMcts::setThreadPool(ThreadPool *pool) {
+  sharedPool_ = pool;
+}
+
+void SorryMcts::setLeafParallelism(int rolloutsPerLeaf, int workerCount) {
+  if (rolloutsPerLeaf < 1) {
+    throw std::runtime_error("Must do at least one rollout per leaf");
+  }
+  rolloutsPerLeaf_ = rolloutsPerLeaf;
+  if (rolloutsPerLeaf_ == 1) {
+    rolloutPool_.reset();
+  } else {
+    rolloutPool_ = std::make_unique<ThreadPool>(workerCount);
+  }
 }
 
 void SorryMcts::run(const Sorry &startingState, int rolloutCount) {
@@ -85,190 +417,843 @@ void SorryMcts::run(const Sorry &startingState, std::chrono::duration<double> ti
 }
 
 void SorryMcts::run(const Sorry &startingState, internal::LoopCondition *loopCondition) {
+  stopPondering();
   // Since we've been invoked, we know that we are the current player.
   ourPlayer_ = startingState.getPlayerTurn();
-  {
-    std::unique_lock lock(treeMutex_);
-    if (rootNode_ != nullptr) {
-      delete rootNode_;
+  setRoot(startingState);
+  search(startingState, loopCondition, /*stopWhenDecided=*/true);
+}
+
+void SorryMcts::startPondering(const Sorry &state, PlayerColor ourPlayer) {
+  stopPondering();
+  if (state.gameDone()) {
+    return;
+  }
+  ourPlayer_ = ourPlayer;
+  setRoot(state);
+  ponderTerminator_.setDone(false);
+  ponderThread_ = std::thread([this, state]() {
+    search(state, &ponderTerminator_, /*stopWhenDecided=*/false);
+  });
+}
+
+void SorryMcts::stopPondering() {
+  if (!ponderThread_.joinable()) {
+    return;
+  }
+  ponderTerminator_.setDone(true);
+  ponderThread_.join();
+}
+
+void SorryMcts::setRoot(const Sorry &state) {
+  std::unique_lock lock(treeMutex_);
+  const uint64_t rootKey = keyOf(state);
+  Node *newRoot = nullptr;
+  if (rootNode_ != nullptr) {
+    newRoot = detachDescendant(rootKey);
+    delete rootNode_;
+  }
+  SearchStats unusedStats;
+  rootNode_ = (newRoot != nullptr ? newRoot : new Node(rootKey, statisticsFor(state, rootKey, unusedStats, /*isRoot=*/true)));
+  nodeCount_ = subtreeSize(rootNode_);
+  iterationCount_ = 0;
+  publishRootSnapshot(/*wait=*/true);
+}
+
+Node* SorryMcts::detachDescendant(uint64_t key) {
+  if (rootNode_->key == key) {
+    Node *result = rootNode_;
+    rootNode_ = nullptr;
+    return result;
+  }
+  // Only look through one round of opponents' turns; positions where it's our turn again are as far as a real game gets before the next `run`.
+  std::vector<Node*> toVisit = {rootNode_};
+  while (!toVisit.empty()) {
+    Node *node = toVisit.back();
+    toVisit.pop_back();
+    for (auto &successorsOfAction : node->successors) {
+      for (auto it=successorsOfAction.begin(); it!=successorsOfAction.end(); ++it) {
+        Node *successor = *it;
+        if (successor->key == key) {
+          successorsOfAction.erase(it);
+          return successor;
+        }
+        if (successor->statistics->playerTurn != ourPlayer_) {
+          toVisit.push_back(successor);
+        }
+      }
     }
-    rootNode_ = new Node(startingState);
-    iterationCount_ = 0;
   }
-  if (startingState.getActions().size() == 0) {
+  return nullptr;
+}
+
+void SorryMcts::search(const Sorry &startingState, internal::LoopCondition *loopCondition, bool stopWhenDecided) {
+  // When pondering, the root is an opponent's turn, and in information set search its actions can grow while we search; only the size before searching is used here.
+  const size_t actionCount = [this]() {
+    std::lock_guard guard(rootNode_->statistics->lock);
+    return rootNode_->statistics->actions.size();
+  }();
+  if (actionCount == 0) {
     // No actions, must be done with the game.
     return;
   }
-  while (loopCondition->condition()) {
-    doSingleStep(startingState);
-    ++iterationCount_;
-    if (startingState.getActions().size() == 1) {
-      // If there's only one option, we're done.
-      return;
+  const bool forced = stopWhenDecided && actionCount == 1;
+  const bool checkDecided = stopWhenDecided && earlyStopping_;
+  std::atomic<bool> decided{false};
+  const auto startTime = Clock::now();
+  const size_t startingNodeCount = nodeCount_;
+  SearchStats combinedStats;
+  std::mutex combinedStatsMutex;
+  auto searchLoop = [&]() {
+    // Each thread owns its random engine; the engine is used for both the card draws of the descent and the rollout.
+    std::mt19937 eng = createRandomEngine();
+    // Each thread also counts on its own, and the counts are combined once it's done.
+    SearchStats stats;
+    while (!decided && loopCondition->claimIteration()) {
+      while (recycleRequested_) {
+        // Stay out of the tree until it has been trimmed.
+        std::this_thread::yield();
+      }
+      {
+        std::shared_lock lock(treeMutex_);
+        doSingleStep(startingState, eng, stats);
+      }
+      if (recycleRequested_) {
+        recycleNodes(stats);
+      }
+      const int iterationCount = ++iterationCount_;
+      if (iterationCount % kIterationsPerSnapshot == 0) {
+        publishRootSnapshot(/*wait=*/false);
+      }
+      if (forced) {
+        // If there's only one option, we're done.
+        break;
+      }
+      loopCondition->oneIterationComplete();
+      if (checkDecided && iterationCount % kIterationsPerDecidedCheck == 0) {
+        if (const auto remainingIterations = loopCondition->remainingIterations()) {
+          if (rootIsDecided(*remainingIterations)) {
+            decided = true;
+          }
+        }
+      }
+    }
+    std::lock_guard guard(combinedStatsMutex);
+    combinedStats.merge(stats);
+  };
+  if (seed_) {
+    combinedStats = searchInRounds(startingState, loopCondition, forced, checkDecided);
+  } else if (forced || threadCount_ == 1) {
+    searchLoop();
+  } else if (sharedPool_ != nullptr) {
+    // Helpers which only get a worker once the loop condition is over return right away.
+    std::vector<std::future<void>> helpers;
+    helpers.reserve(threadCount_-1);
+    for (int i=1; i<threadCount_; ++i) {
+      helpers.push_back(sharedPool_->submit(searchLoop));
+    }
+    searchLoop();
+    for (auto &helper : helpers) {
+      sharedPool_->wait(helper);
+    }
+  } else {
+    std::vector<std::thread> helpers;
+    helpers.reserve(threadCount_-1);
+    for (int i=1; i<threadCount_; ++i) {
+      helpers.emplace_back(searchLoop);
+    }
+    searchLoop();
+    for (std::thread &helper : helpers) {
+      helper.join();
     }
-    loopCondition->oneIterationComplete();
   }
+  publishRootSnapshot(/*wait=*/true);
+  combinedStats.peakTreeNodeCount = std::max<uint64_t>(combinedStats.peakTreeNodeCount, startingNodeCount);
+  measureTree(combinedStats);
+  combinedStats.wallSeconds = secondsSince(startTime);
+  std::lock_guard guard(searchStatsMutex_);
+  searchStats_ = combinedStats;
+}
+
+SearchStats SorryMcts::searchInRounds(const Sorry &startingState, internal::LoopCondition *loopCondition, bool forced, bool checkDecided) {
+  // Iterations run in lock-step rounds. In each round, one descent per thread is made in thread order, then their rollouts run in parallel, then their results are backpropagated in thread order. Nothing then depends on how the threads are scheduled, at the cost of threads waiting for each other at the end of each round. Time limits still vary in how many iterations they allow.
+  const int threadCount = (forced ? 1 : threadCount_);
+  // Each thread gets its own stream of random numbers, derived from the seed, the position and the thread's index.
+  const uint64_t searchSeed = hashCombine(*seed_, keyOf(startingState));
+  std::vector<std::mt19937> engines;
+  engines.reserve(threadCount);
+  for (int i=0; i<threadCount; ++i) {
+    const uint64_t threadSeed = hashCombine(searchSeed, i);
+    std::seed_seq seedSequence{static_cast<uint32_t>(threadSeed), static_cast<uint32_t>(threadSeed >> 32)};
+    engines.emplace_back(seedSequence);
+  }
+  std::vector<SearchStats> threadStats(threadCount);
+  // The first thread's rollouts run on this thread, the others' on the shared pool if there is one.
+  std::unique_ptr<ThreadPool> ownPool;
+  if (threadCount > 1 && sharedPool_ == nullptr) {
+    ownPool = std::make_unique<ThreadPool>(threadCount-1);
+  }
+  ThreadPool *pool = (sharedPool_ != nullptr ? sharedPool_ : ownPool.get());
+  std::vector<Descent> descents;
+  descents.reserve(threadCount);
+  std::vector<std::vector<Playout>> playouts(threadCount);
+  // Whether the endgame solver solves a position within its budget depends on what it already knows, so what the rollouts of a round solve is only shared with the solver once the round is over, in thread order.
+  std::vector<EndgameSolver::Solutions> endgameSolutions(threadCount);
+  std::vector<std::future<void>> pendingRollouts;
+  bool decided = false;
+  while (!decided && loopCondition->condition()) {
+    if (recycleRequested_) {
+      recycleNodes(threadStats[0]);
+    }
+    // Don't start more iterations than were asked for, or an iteration count wouldn't be reproducible across thread counts.
+    int roundSize = threadCount;
+    if (const auto remainingIterations = loopCondition->remainingIterations()) {
+      roundSize = std::clamp(*remainingIterations, 1, threadCount);
+    }
+    // Descents one after the other, so that each sees the virtual losses of the ones before it in the same order every time.
+    descents.clear();
+    {
+      std::shared_lock lock(treeMutex_);
+      for (int i=0; i<roundSize; ++i) {
+        descents.push_back(descend(startingState, engines[i], threadStats[i]));
+      }
+    }
+    pendingRollouts.clear();
+    for (int i=1; i<roundSize; ++i) {
+      pendingRollouts.push_back(pool->submit([&, i]() {
+        playouts[i] = playOut(descents[i].state, engines[i], threadStats[i], &endgameSolutions[i]);
+      }));
+    }
+    playouts[0] = playOut(descents[0].state, engines[0], threadStats[0], &endgameSolutions[0]);
+    for (auto &pendingRollout : pendingRollouts) {
+      pool->wait(pendingRollout);
+    }
+    if (endgameSolver_ != nullptr) {
+      for (int i=0; i<roundSize; ++i) {
+        endgameSolver_->remember(endgameSolutions[i]);
+        endgameSolutions[i].clear();
+      }
+    }
+    {
+      std::shared_lock lock(treeMutex_);
+      for (int i=0; i<roundSize; ++i) {
+        const auto backpropStart = Clock::now();
+        backprop(descents[i].path, playouts[i], threadStats[i]);
+        threadStats[i].backpropSeconds += secondsSince(backpropStart);
+      }
+    }
+    if (forced) {
+      ++iterationCount_;
+      break;
+    }
+    for (int i=0; i<roundSize; ++i) {
+      const int iterationCount = ++iterationCount_;
+      if (iterationCount % kIterationsPerSnapshot == 0) {
+        publishRootSnapshot(/*wait=*/false);
+      }
+      loopCondition->oneIterationComplete();
+      if (checkDecided && iterationCount % kIterationsPerDecidedCheck == 0) {
+        if (const auto remainingIterations = loopCondition->remainingIterations()) {
+          decided = decided || rootIsDecided(*remainingIterations);
+        }
+      }
+    }
+  }
+  SearchStats combinedStats;
+  for (const SearchStats &stats : threadStats) {
+    combinedStats.merge(stats);
+  }
+  return combinedStats;
+}
+
+void SorryMcts::publishRootSnapshot(bool wait) {
+  std::unique_lock lock(snapshotWriteMutex_, std::defer_lock);
+  if (wait) {
+    lock.lock();
+  } else if (!lock.try_lock()) {
+    // Another thread is publishing right now, which is just as good.
+    return;
+  }
+  RootSnapshot snapshot{};
+  if (rootNode_ != nullptr) {
+    const NodeStatistics &rootStatistics = *rootNode_->statistics;
+    std::lock_guard guard(rootStatistics.lock);
+    snapshot.actionCount = std::min(rootStatistics.expandedActionCount(), RootSnapshot::kMaxActionCount);
+    scoreActions(rootStatistics, snapshot.actionCount, /*withExploration=*/false, snapshot.scores.data());
+    std::copy(rootStatistics.actions.begin(), rootStatistics.actions.begin()+snapshot.actionCount, snapshot.actions.begin());
+    std::copy(rootStatistics.gameCounts.begin(), rootStatistics.gameCounts.begin()+snapshot.actionCount, snapshot.gameCounts.begin());
+    snapshot.totalWinCounts = rootStatistics.totalWinCounts;
+  }
+  rootSnapshot_->store(snapshot);
+}
+
+bool SorryMcts::rootIsDecided(int remainingIterations) const {
+  const NodeStatistics &rootStatistics = *rootNode_->statistics;
+  std::lock_guard guard(rootStatistics.lock);
+  const size_t expandedActionCount = rootStatistics.expandedActionCount();
+  if (expandedActionCount == 0) {
+    return false;
+  }
+  // Each remaining iteration adds this many games to one action.
+  const float remainingGames = static_cast<float>(remainingIterations) * rolloutsPerLeaf_;
+  const size_t best = mostPlayedAction(rootStatistics);
+  const float bestGameCount = rootStatistics.gameCounts[best];
+  for (size_t i=0; i<expandedActionCount; ++i) {
+    if (i == best) {
+      continue;
+    }
+    // Another action only takes over once the search plays it more than the best one. Even if every remaining game went to this one, it could not catch up.
+    if (rootStatistics.gameCounts[i] + rootStatistics.virtualLosses[i] + remainingGames >= bestGameCount) {
+      return false;
+    }
+  }
+  // An untried action would start from 0 games.
+  return remainingGames < bestGameCount;
+}
+
+size_t SorryMcts::mostPlayedAction(const NodeStatistics &statistics) {
+  const size_t expandedActionCount = statistics.expandedActionCount();
+  return std::max_element(statistics.gameCounts.begin(), statistics.gameCounts.begin()+expandedActionCount) - statistics.gameCounts.begin();
+}
+
+SearchStats SorryMcts::getSearchStats() const {
+  std::lock_guard guard(searchStatsMutex_);
+  return searchStats_;
 }
 
 void SorryMcts::reset() {
+  stopPondering();
   std::unique_lock lock(treeMutex_);
   if (rootNode_ != nullptr) {
     delete rootNode_;
     rootNode_ = nullptr;
   }
+  nodeCount_ = 0;
+  publishRootSnapshot(/*wait=*/true);
+  if (transpositionTable_) {
+    transpositionTable_->clear();
+  }
 }
 
 sorry::Action SorryMcts::pickBestAction() const {
   if (rootNode_ == nullptr) {
     throw std::runtime_error("Asking for best action, but have no root node");
   }
-  // TODO: The below code assumes that all possible actions have been visited once.
-  std::vector<size_t> indices(rootNode_->successors.size());
-  std::iota(indices.begin(), indices.end(), 0);
-  int index = select(rootNode_, /*withExploration=*/false, indices);
+  const NodeStatistics &rootStatistics = *rootNode_->statistics;
+  std::lock_guard guard(rootStatistics.lock);
+  if (rootStatistics.expandedActionCount() == 0) {
+    throw std::runtime_error("Asking for best action, but have not tried any");
+  }
+  // With early stopping, the search only makes sure that the most played action can't change, so that is the one to pick.
+  const size_t index = (earlyStopping_ ? mostPlayedAction(rootStatistics) : select(rootStatistics, /*withExploration=*/false));
   // printActions(rootNode_, 2);
-  return rootNode_->successors.at(index)->action;
+  return Action::unpack(rootStatistics.actions.at(index));
 }
 
 std::vector<ActionScore> SorryMcts::getActionScores() const {
-  std::unique_lock lock(treeMutex_);
-  if (rootNode_ == nullptr) {
-    // No known actions yet.
-    return {};
-  }
-  std::vector<size_t> indices(rootNode_->successors.size());
-  std::iota(indices.begin(), indices.end(), 0);
+  const RootSnapshot snapshot = rootSnapshot_->load();
   std::vector<ActionScore> result;
-  for (size_t index : indices) {
-    const Node *successor = rootNode_->successors.at(index);
-    const double score = nodeScore(successor, rootNode_, /*withExploration=*/false);
-    result.emplace_back(ActionScore{.action=successor->action,
-                                    .score=score});
+  result.reserve(snapshot.actionCount);
+  for (size_t index=0; index<snapshot.actionCount; ++index) {
+    result.emplace_back(ActionScore{.action=Action::unpack(snapshot.actions[index]),
+                                    .score=snapshot.scores[index],
+                                    .visitCount=static_cast<int>(snapshot.gameCounts[index])});
   }
   return result;
 }
 
 std::vector<double> SorryMcts::getWinRates() const {
-  std::unique_lock lock(treeMutex_);
-  if (rootNode_ == nullptr) {
-    return { 0.25, 0.25, 0.25, 0.25 };
-  }
-  const double sum = rootNode_->winCount[0] + rootNode_->winCount[1] + rootNode_->winCount[2] + rootNode_->winCount[3];
+  const RootSnapshot snapshot = rootSnapshot_->load();
+  const auto &winCount = snapshot.totalWinCounts;
+  const double sum = winCount[0] + winCount[1] + winCount[2] + winCount[3];
   if (sum == 0) {
     return { 0.25, 0.25, 0.25, 0.25 };
   }
-  return { rootNode_->winCount[0] / sum,
-           rootNode_->winCount[1] / sum,
-           rootNode_->winCount[2] / sum,
-           rootNode_->winCount[3] / sum };
-};
-
+  return { winCount[0] / sum,
+           winCount[1] / sum,
+           winCount[2] / sum,
+           winCount[3] / sum };
+}
 
 int SorryMcts::getIterationCount() const {
-  std::unique_lock lock(treeMutex_);
   return iterationCount_;
 }
 
-void SorryMcts::doSingleStep(const Sorry &startingState) {
-  Sorry state = startingState;
-  std::unique_lock lock(treeMutex_);
+float SorryMcts::getVirtualLossTotal() const {
+  std::shared_lock lock(treeMutex_);
+  if (rootNode_ == nullptr) {
+    return 0;
+  }
+  float total = 0;
+  std::vector<const Node*> toVisit = {rootNode_};
+  while (!toVisit.empty()) {
+    const Node *node = toVisit.back();
+    toVisit.pop_back();
+    {
+      const NodeStatistics &statistics = *node->statistics;
+      std::lock_guard guard(statistics.lock);
+      total = std::accumulate(statistics.virtualLosses.begin(), statistics.virtualLosses.end(), total);
+    }
+    for (const auto &successorsOfAction : node->successors) {
+      toVisit.insert(toVisit.end(), successorsOfAction.begin(), successorsOfAction.end());
+    }
+  }
+  return total;
+}
+
+void SorryMcts::doSingleStep(const Sorry &startingState, std::mt19937 &eng, SearchStats &stats) {
+  const Descent descent = descend(startingState, eng, stats);
+  const std::vector<Playout> playouts = playOut(descent.state, eng, stats, /*deferredEndgameSolutions=*/nullptr);
+  // Propagate the result of the rollouts back up through the path.
+  const auto backpropStart = Clock::now();
+  backprop(descent.path, playouts, stats);
+  stats.backpropSeconds += secondsSince(backpropStart);
+}
+
+Descent SorryMcts::descend(const Sorry &startingState, std::mt19937 &eng, SearchStats &stats) {
+  // Charges the time since the previous phase ended to `phaseSeconds`.
+  auto phaseStart = Clock::now();
+  auto endPhase = [&](double &phaseSeconds) {
+    const auto now = Clock::now();
+    phaseSeconds += std::chrono::duration<double>(now - phaseStart).count();
+    phaseStart = now;
+  };
+  Descent descent{startingState, {}};
+  Sorry &state = descent.state;
+  if (informationSetSearch_) {
+    // Search a world consistent with what we know, picked at random.
+    state.randomizeHiddenInformation(ourPlayer_, eng);
+  }
   Node *currentNode = rootNode_;
-  while (!state.gameDone()) {
-    // Get all actions.
-    const auto actions = state.getActions();
-    bool rolledOut=false;
-    std::vector<size_t> indices;
-    for (const Action &action : actions) {
-      // If we don't yet have a node for this action, select it.
-      bool foundOurAction = false;
-      for (size_t i=0; i<currentNode->successors.size(); ++i) {
-        if (currentNode->successors.at(i)->state == state &&
-            currentNode->successors.at(i)->action == action) {
-          // This is our action.
-          indices.push_back(i);
-          foundOurAction = true;
-          break;
-        }
+  auto &path = descent.path;
+  while (true) {
+    NodeStatistics &statistics = *currentNode->statistics;
+    size_t actionIndex;
+    bool expanded;
+    uint32_t action;
+    if (informationSetSearch_ && statistics.playerTurn != ourPlayer_) {
+      // Never progressively widened, since the opponent's legal actions vary between visits.
+      std::tie(actionIndex, expanded) = selectAvailable(statistics, state, stats);
+      auto lock = lockCountingWait(statistics.lock, stats);
+      action = statistics.actions[actionIndex];
+    } else {
+      auto lock = lockCountingWait(statistics.lock, stats);
+      // Take the next untried action, if there is one and the node is allowed another child. Otherwise, select among the tried ones.
+      expanded = statistics.expandedCount < std::min(statistics.actions.size(), allowedChildCount(statistics));
+      if (expanded) {
+        actionIndex = statistics.expandedCount++;
+      } else {
+        actionIndex = select(statistics, /*withExploration=*/true);
       }
-      if (foundOurAction) {
-        // Already have a child for this action.
-        continue;
-      }
-      // Never tried this action. Create a node for it and then rollout.
-      currentNode->successors.push_back(new Node(state, action, currentNode));
-      state.doAction(action, eng_);
-
-      // Unlock the mutex protecting the root node during rollout.
-      lock.unlock();
-      const sorry::PlayerColor winner = rollout(state);
-      lock.lock();
-
-      // Propagate the result of the rollout back up through the parents.
-      backprop(currentNode->successors.back(), winner);
-      rolledOut = true;
+      // Mark the chosen action as in-flight before releasing the lock so that other threads steer away from it.
+      ++statistics.virtualLosses[actionIndex];
+      action = statistics.actions[actionIndex];
+    }
+    path.emplace_back(&statistics, actionIndex);
+    state.doAction(Action::unpack(action), eng);
+
+    endPhase(stats.selectionSeconds);
+    if (expanded || state.gameDone()) {
+      break;
+    }
+    Node *successor = getOrCreateSuccessor(currentNode, actionIndex, state, stats);
+    endPhase(stats.expansionSeconds);
+    if (successor == nullptr) {
+      // Out of nodes; keep refining the statistics we have by playing out from here without adding to the tree.
       break;
     }
-    if (rolledOut) {
-      return;
+    currentNode = successor;
+  }
+  stats.addDepth(path.size());
+  return descent;
+}
+
+std::vector<Playout> SorryMcts::playOut(const Sorry &state, std::mt19937 &eng, SearchStats &stats, EndgameSolver::Solutions *deferredEndgameSolutions) {
+  const auto rolloutStart = Clock::now();
+  std::vector<Playout> playouts;
+  std::optional<std::array<float, 4>> solvedValue;
+  if (endgameSolver_ != nullptr && !state.gameDone() && endgameSolver_->isEligible(state)) {
+    solvedValue = endgameSolver_->solve(state, deferredEndgameSolutions);
+    ++(solvedValue ? stats.endgameSolvedCount : stats.endgameUnsolvedCount);
+  }
+  if (state.gameDone()) {
+    playouts.push_back(finishedPlayout(state));
+  } else if (solvedValue) {
+    // Counts as many games as the rollouts it replaces, so that the leaf weighs the same as any other.
+    playouts.assign(rolloutsPerLeaf_, Playout{*solvedValue, 0, {}});
+  } else {
+    playouts = leafRollouts(state, eng);
+    for (const Playout &playout : playouts) {
+      stats.addRolloutLength(playout.plyCount);
+    }
+  }
+  stats.rolloutSeconds += secondsSince(rolloutStart);
+  return playouts;
+}
+
+size_t SorryMcts::allowedChildCount(const NodeStatistics &statistics) const {
+  if (progressiveWideningCoefficient_ == 0) {
+    return std::numeric_limits<size_t>::max();
+  }
+  const double allowed = progressiveWideningCoefficient_ * std::pow(statistics.totalGameCount, progressiveWideningExponent_);
+  return std::max<size_t>(1, static_cast<size_t>(allowed));
+}
+
+std::pair<size_t, bool> SorryMcts::selectAvailable(NodeStatistics &statistics, const Sorry &state, SearchStats &stats) const {
+  const auto legalActions = state.getActions();
+  std::vector<size_t> legalIndices;
+  legalIndices.reserve(legalActions.size());
+  auto lock = lockCountingWait(statistics.lock, stats);
+  for (const Action &legalAction : legalActions) {
+    legalIndices.push_back(statistics.indexOf(legalAction.pack()));
+  }
+  size_t actionIndex = legalIndices.front();
+  bool expanded = false;
+  for (size_t index : legalIndices) {
+    ++statistics.availabilityCounts[index];
+    if (!expanded && statistics.gameCounts[index] + statistics.virtualLosses[index] == 0) {
+      // Never tried in any determinization.
+      actionIndex = index;
+      expanded = true;
+    }
+  }
+  if (!expanded) {
+    // UCB over the legal actions, where an action's parent visit count is the number of times it was available.
+    const auto &winCounts = statistics.winCounts[static_cast<int>(statistics.playerTurn)];
+    float bestScore = -std::numeric_limits<float>::infinity();
+    for (size_t index : legalIndices) {
+      const float visitCount = statistics.gameCounts[index] + statistics.virtualLosses[index];
+      float value = winCounts[index] / visitCount;
+      if (raveEquivalenceParameter_ > 0) {
+        // Same blend as in scoreActions().
+        const float beta = std::sqrt(raveEquivalenceParameter_ / (3*visitCount + raveEquivalenceParameter_));
+        value = (1-beta) * value + beta * statistics.raveWinCounts[index] / std::max(1.0f, statistics.raveGameCounts[index]);
+      }
+      const float score = value + explorationConstant_ * std::sqrt(std::log(statistics.availabilityCounts[index]) / visitCount);
+      if (score > bestScore) {
+        bestScore = score;
+        actionIndex = index;
+      }
+    }
+  }
+  ++statistics.virtualLosses[actionIndex];
+  return {actionIndex, expanded};
+}
+
+uint64_t SorryMcts::keyOf(const Sorry &state) const {
+  if (informationSetSearch_) {
+    return state.informationSetHash(ourPlayer_);
+  }
+  return state.hash();
+}
+
+std::shared_ptr<NodeStatistics> SorryMcts::statisticsFor(const Sorry &state, uint64_t key, SearchStats &stats, bool isRoot) {
+  const bool orderByPrior = progressiveWideningCoefficient_ > 0;
+  auto create = [&state, &stats, orderByPrior]() {
+    auto statistics = std::make_shared<NodeStatistics>(state, orderByPrior);
+    ++stats.statisticsAllocated;
+    return statistics;
+  };
+  if (!transpositionTable_) {
+    return create();
+  }
+  auto statistics = transpositionTable_->findOrInsert(key, create);
+  if (statistics == nullptr && isRoot) {
+    // A search needs a root, even one the table has no room for.
+    return create();
+  }
+  return statistics;
+}
+
+Node* SorryMcts::getOrCreateSuccessor(Node *node, size_t actionIndex, const Sorry &state, SearchStats &stats) {
+  const uint64_t key = keyOf(state);
+  auto findSuccessor = [&]() -> Node* {
+    if (actionIndex >= node->successors.size()) {
+      return nullptr;
+    }
+    for (Node *successor : node->successors[actionIndex]) {
+      if (successor->key == key) {
+        return successor;
+      }
+    }
+    return nullptr;
+  };
+  {
+    auto lock = lockCountingWait(node->successorsMutex, stats);
+    if (Node *successor = findSuccessor()) {
+      return successor;
     }
-    // All possible actions have been seen before. Select one.
-    int index = select(currentNode, /*withExploration=*/true, indices);
-    currentNode = currentNode->successors.at(index);
-    state.doAction(currentNode->action, eng_);
   }
-  // Game is done.
-  backprop(currentNode, state.getWinner());
+  if (nodeBudget_ > 0 && nodeCount_ >= nodeBudget_) {
+    // Don't bother generating statistics which would not fit.
+    return nodeBudgetExhausted();
+  }
+  // Look up or generate the statistics of the new node without holding the lock.
+  auto statistics = statisticsFor(state, key, stats, /*isRoot=*/false);
+  if (statistics == nullptr) {
+    // The transposition table is full of statistics the tree still uses. Treat it like the node budget running out, so that the tree's memory stays within the table's.
+    return nodeBudgetExhausted();
+  }
+  auto newNode = std::make_unique<Node>(key, std::move(statistics));
+  auto lock = lockCountingWait(node->successorsMutex, stats);
+  if (Node *successor = findSuccessor()) {
+    // Another thread got here first.
+    return successor;
+  }
+  const size_t previousNodeCount = nodeCount_.fetch_add(1);
+  if (previousNodeCount >= nodeBudget_ && nodeBudget_ > 0) {
+    --nodeCount_;
+    return nodeBudgetExhausted();
+  }
+  ++stats.nodesAllocated;
+  stats.peakTreeNodeCount = std::max<uint64_t>(stats.peakTreeNodeCount, previousNodeCount+1);
+  if (actionIndex >= node->successors.size()) {
+    node->successors.resize(actionIndex+1);
+  }
+  node->successors[actionIndex].push_back(newNode.get());
+  return newNode.release();
 }
 
-int SorryMcts::select(const Node *currentNode, bool withExploration, const std::vector<size_t> &indices) const {
-  if (indices.size() == 1) {
-    return indices.at(0);
+Node* SorryMcts::nodeBudgetExhausted() {
+  if (nodeBudgetPolicy_ == NodeBudgetPolicy::kRecycle) {
+    recycleRequested_ = true;
   }
-  std::vector<double> scores;
-  for (size_t index : indices) {
-    const Node *successor = currentNode->successors.at(index);
-    const double score = nodeScore(successor, currentNode, withExploration);
-    scores.push_back(score);
+  return nullptr;
+}
+
+void SorryMcts::recycleNodes(SearchStats &stats) {
+  std::unique_lock lock(treeMutex_);
+  if (!recycleRequested_) {
+    // Another thread already did it.
+    return;
   }
-  auto it = std::max_element(scores.begin(), scores.end());
-  return indices.at(distance(scores.begin(), it));
+  // Free the least visited subtrees until a quarter of the budget is available again. A node is visited at most as often as its parent, so the least visited nodes are mostly whole subtrees near the bottom of the tree. If it was the transposition table which filled up, free a quarter of the tree instead.
+  const size_t nodeCount = nodeCount_;
+  const size_t budget = (nodeBudget_ > 0 ? std::min(nodeBudget_, nodeCount) : nodeCount);
+  const size_t targetNodeCount = budget - budget/4;
+  if (nodeCount_ > targetNodeCount) {
+    std::vector<float> visitCounts;
+    visitCounts.reserve(nodeCount_);
+    std::vector<const Node*> toVisit = {rootNode_};
+    while (!toVisit.empty()) {
+      const Node *node = toVisit.back();
+      toVisit.pop_back();
+      for (const auto &successorsOfAction : node->successors) {
+        for (const Node *successor : successorsOfAction) {
+          visitCounts.push_back(successor->statistics->totalGameCount);
+          toVisit.push_back(successor);
+        }
+      }
+    }
+    size_t toFree = std::min<size_t>(nodeCount_ - targetNodeCount, visitCounts.size());
+    if (toFree > 0) {
+      std::nth_element(visitCounts.begin(), visitCounts.begin()+toFree-1, visitCounts.end());
+      const float threshold = visitCounts[toFree-1];
+      size_t freed = 0;
+      // Nodes visited less than the threshold always go; ties go only until enough is freed.
+      std::function<void(Node*)> prune = [&](Node *node) {
+        for (auto &successorsOfAction : node->successors) {
+          auto kept = successorsOfAction.begin();
+          for (Node *successor : successorsOfAction) {
+            const float visitCount = successor->statistics->totalGameCount;
+            if (visitCount < threshold || (visitCount == threshold && freed < toFree)) {
+              freed += subtreeSize(successor);
+              delete successor;
+            } else {
+              prune(successor);
+              *kept++ = successor;
+            }
+          }
+          successorsOfAction.erase(kept, successorsOfAction.end());
+        }
+      };
+      prune(rootNode_);
+      nodeCount_ -= freed;
+      stats.nodesRecycled += freed;
+    }
+  }
+  recycleRequested_ = false;
 }
 
-sorry::PlayerColor SorryMcts::rollout(Sorry state) {
+void SorryMcts::measureTree(SearchStats &stats) const {
+  std::shared_lock lock(treeMutex_);
+  stats.treeNodeCount = 0;
+  stats.treeBytes = 0;
+  // With a transposition table, nodes can share statistics; count each only once.
+  std::unordered_set<const NodeStatistics*> seenStatistics;
+  std::vector<const Node*> toVisit = {rootNode_};
+  while (!toVisit.empty()) {
+    const Node *node = toVisit.back();
+    toVisit.pop_back();
+    ++stats.treeNodeCount;
+    stats.treeBytes += sizeof(Node);
+    const NodeStatistics *statistics = node->statistics.get();
+    if (!transpositionTable_ || seenStatistics.insert(statistics).second) {
+      std::lock_guard guard(statistics->lock);
+      stats.treeBytes += NodeStatistics::estimatedBytes(statistics->actions.size());
+    }
+    for (const auto &successorsOfAction : node->successors) {
+      toVisit.insert(toVisit.end(), successorsOfAction.begin(), successorsOfAction.end());
+    }
+  }
+}
+
+int SorryMcts::select(const NodeStatistics &statistics, bool withExploration) const {
+  const size_t expandedActionCount = statistics.expandedActionCount();
+  if (expandedActionCount == 1) {
+    return 0;
+  }
+  // Reused across calls so that selection never allocates once it has seen the widest node.
+  thread_local std::vector<float> scores;
+  if (scores.size() < expandedActionCount) {
+    scores.resize(expandedActionCount);
+  }
+  scoreActions(statistics, expandedActionCount, withExploration, scores.data());
+  return std::distance(scores.begin(), std::max_element(scores.begin(), scores.begin()+expandedActionCount));
+}
+
+void SorryMcts::scoreActions(const NodeStatistics &statistics, size_t actionCount, bool withExploration, float * __restrict scores) const {
+  const float * __restrict gameCounts = statistics.gameCounts.data();
+  const float * __restrict virtualLosses = statistics.virtualLosses.data();
+  const float * __restrict winCounts = statistics.winCounts[static_cast<int>(statistics.playerTurn)].data();
+  // All loops are branch-free so that the compiler vectorizes them. In-flight descents count as visits which have not (yet) been won. An action with no visits has no wins either, so clamping its visit count to 1 scores it 0.
+  if (raveEquivalenceParameter_ == 0) {
+    for (size_t i=0; i<actionCount; ++i) {
+      scores[i] = winCounts[i] / std::max(1.0f, gameCounts[i] + virtualLosses[i]);
+    }
+  } else {
+    // Blend in the all-moves-as-first value, trusting it less as the action's own visits grow: beta = sqrt(k / (3n + k)).
+    const float * __restrict raveGameCounts = statistics.raveGameCounts.data();
+    const float * __restrict raveWinCounts = statistics.raveWinCounts.data();
+    const float k = raveEquivalenceParameter_;
+    for (size_t i=0; i<actionCount; ++i) {
+      const float visitCount = gameCounts[i] + virtualLosses[i];
+      const float beta = std::sqrt(k / (3.0f*visitCount + k));
+      const float value = winCounts[i] / std::max(1.0f, visitCount);
+      const float raveValue = raveWinCounts[i] / std::max(1.0f, raveGameCounts[i]);
+      scores[i] = (1.0f-beta) * value + beta * raveValue;
+    }
+  }
+  if (!withExploration) {
+    return;
+  }
+  const float logParentVisitCount = std::log(std::max(1.0f, statistics.totalGameCount));
+  const float explorationConstant = explorationConstant_;
+  for (size_t i=0; i<actionCount; ++i) {
+    const float inverseVisitCount = 1.0f / std::max(1.0f, gameCounts[i] + virtualLosses[i]);
+    scores[i] += explorationConstant * std::sqrt(logParentVisitCount * inverseVisitCount);
+  }
+}
+
+Playout SorryMcts::rollout(Sorry state, std::mt19937 &eng) const {
+  Playout playout;
+  const bool recordActions = raveEquivalenceParameter_ > 0;
   while (!state.gameDone()) {
+    if (rolloutDepthLimit_ > 0 && playout.plyCount == rolloutDepthLimit_) {
+      // Cut the rollout short and let the evaluator guess how it would have ended.
+      const auto evaluation = evaluatePosition(state);
+      std::copy(evaluation.begin(), evaluation.end(), playout.wins.begin());
+      break;
+    }
+    if (raceTablebase_ != nullptr) {
+      if (const auto raceValue = raceTablebase_->probe(state)) {
+        playout.wins = *raceValue;
+        break;
+      }
+    }
+    ++playout.plyCount;
     const auto actions = state.getActions();
     if (actions.empty()) {
       throw std::runtime_error("No actions to take");
     }
-    std::uniform_int_distribution<int> dist(0, actions.size()-1);
-    const auto action = actions[dist(eng_)];
-    state.doAction(action, eng_);
+    const auto &action = actions[rolloutPolicy_->chooseAction(state, actions, eng)];
+    if (recordActions) {
+      playout.actions.push_back(action.pack());
+    }
+    state.doAction(action, eng);
   }
-  // Game is over.
-  return state.getWinner();
+  if (state.gameDone()) {
+    playout.wins[static_cast<int>(state.getWinner())] = 1;
+  }
+  std::sort(playout.actions.begin(), playout.actions.end());
+  playout.actions.erase(std::unique(playout.actions.begin(), playout.actions.end()), playout.actions.end());
+  return playout;
 }
 
-void SorryMcts::backprop(Node *current, sorry::PlayerColor winner) {
-  while (1) {
-    ++current->winCount[static_cast<int>(winner)];
-    ++current->gameCount;
-    if (current->parent == nullptr) {
-      // Reached the root. We're done.
-      break;
-    }
-    current = current->parent;
+Playout SorryMcts::finishedPlayout(const Sorry &state) {
+  Playout playout;
+  playout.wins[static_cast<int>(state.getWinner())] = 1;
+  return playout;
+}
+
+std::vector<Playout> SorryMcts::leafRollouts(const Sorry &state, std::mt19937 &eng) {
+  std::vector<Playout> playouts;
+  if (state.gameDone()) {
+    // Every rollout would end the same way; count it once.
+    playouts.push_back(finishedPlayout(state));
+    return playouts;
+  }
+  if (rolloutsPerLeaf_ == 1) {
+    // Nothing to hand out; there may not even be a pool.
+    playouts.push_back(rollout(state, eng));
+    return playouts;
   }
+  // Hand all but one rollout to the pool and play the last one on this thread while waiting. Each pooled rollout gets its own engine, seeded from ours.
+  ThreadPool &pool = (sharedPool_ != nullptr ? *sharedPool_ : *rolloutPool_);
+  std::vector<std::future<Playout>> pendingPlayouts;
+  pendingPlayouts.reserve(rolloutsPerLeaf_-1);
+  for (int i=1; i<rolloutsPerLeaf_; ++i) {
+    const auto seed = eng();
+    pendingPlayouts.push_back(pool.submit([this, state, seed]() {
+      std::mt19937 rolloutEng(seed);
+      return rollout(state, rolloutEng);
+    }));
+  }
+  playouts.reserve(rolloutsPerLeaf_);
+  playouts.push_back(rollout(state, eng));
+  for (auto &pendingPlayout : pendingPlayouts) {
+    playouts.push_back(pool.wait(pendingPlayout));
+  }
+  return playouts;
 }
 
-double SorryMcts::nodeScore(const Node *current, const Node *parent, bool withExploration) const {
-  if (current->gameCount == 0) {
-    return 0;
+void SorryMcts::backprop(const std::vector<std::pair<NodeStatistics*, size_t>> &path, const std::vector<Playout> &playouts, SearchStats &stats) {
+  std::array<float, 4> wins{};
+  for (const Playout &playout : playouts) {
+    for (size_t i=0; i<wins.size(); ++i) {
+      wins[i] += playout.wins[i];
+    }
   }
-  const double score = current->score();
-  if (!withExploration) {
-    return score;
+  const int gameCount = playouts.size();
+  const bool updateRave = raveEquivalenceParameter_ > 0;
+  // RAVE only: actions taken in the tree from the current node down, sorted.
+  std::vector<uint32_t> pathActions;
+  for (auto it=path.rbegin(); it!=path.rend(); ++it) {
+    auto &[statistics, actionIndex] = *it;
+    auto lock = lockCountingWait(statistics->lock, stats);
+    for (size_t i=0; i<wins.size(); ++i) {
+      statistics->winCounts[i][actionIndex] += wins[i];
+      statistics->totalWinCounts[i] += wins[i];
+    }
+    statistics->gameCounts[actionIndex] += gameCount;
+    statistics->virtualLosses[actionIndex] -= 1;
+    statistics->totalGameCount += gameCount;
+    if (updateRave) {
+      pathActions.insert(std::upper_bound(pathActions.begin(), pathActions.end(), statistics->actions[actionIndex]), statistics->actions[actionIndex]);
+      // Credit every action of this node which the player to move took here or later in the game, as if it had been taken first. Packed actions include the player, so an opponent's equal-looking move does not match.
+      for (const Playout &playout : playouts) {
+        const float won = playout.wins[static_cast<int>(statistics->playerTurn)];
+        for (size_t i=0; i<statistics->actions.size(); ++i) {
+          const uint32_t action = statistics->actions[i];
+          if (std::binary_search(pathActions.begin(), pathActions.end(), action) ||
+              std::binary_search(playout.actions.begin(), playout.actions.end(), action)) {
+            statistics->raveGameCounts[i] += 1;
+            statistics->raveWinCounts[i] += won;
+          }
+        }
+      }
+    }
   }
-  return score + explorationConstant_ * sqrt(log(parent->gameCount) / current->gameCount);
 }
 
 void SorryMcts::printActions(const Node *current, int levels, int currentLevel) const {
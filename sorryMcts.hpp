@@ -2,16 +2,33 @@
 #define SORRY_MCTS_HPP_
 
 #include "action.hpp"
+#include "endgameSolver.hpp"
+#include "searchStats.hpp"
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
+#include <shared_mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class Node;
 class LoopCondition;
+struct Descent;
+class RaceTablebase;
+class RolloutPolicy;
+class ThreadPool;
+struct NodeStatistics;
+struct Playout;
+struct RootSnapshot;
+template<typename T> class SeqLock;
+template<typename Value> class TranspositionTable;
 
 namespace sorry {
 class Sorry;
@@ -22,7 +39,11 @@ namespace internal {
 class LoopCondition {
 public:
   virtual bool condition() const = 0;
+  // Whether a searching thread may start another iteration, which it then must complete. Conditions which allow a fixed number of iterations hand them out here one at a time, so that threads racing for the last ones can't run more than that.
+  virtual bool claimIteration() { return condition(); }
   virtual void oneIterationComplete() = 0;
+  // An estimate of how many more iterations will run, if known.
+  virtual std::optional<int> remainingIterations() const { return std::nullopt; }
 };
 
 } // namespace internal
@@ -36,38 +57,170 @@ private:
   std::atomic<bool> done_{false};
 };
 
+// Stops a search at a deadline which may be moved while the search runs, or right away when told to. Like a time limit, it always lets at least one iteration complete, so that there is an action to pick.
+class DeadlineCondition : public internal::LoopCondition {
+public:
+  explicit DeadlineCondition(std::chrono::steady_clock::time_point deadline);
+  void setDeadline(std::chrono::steady_clock::time_point deadline);
+  // Stop at the end of the current iteration.
+  void stop();
+  bool condition() const override;
+  void oneIterationComplete() override;
+private:
+  static constexpr int kCallsPerClockCheck = 16;
+  std::atomic<std::chrono::steady_clock::rep> deadline_;
+  std::atomic<bool> stopped_{false};
+  std::atomic<int> completedCount_{0};
+  mutable std::atomic<int> callCount_{0};
+  // The clock as of the latest check, since it is only read every few calls.
+  mutable std::atomic<std::chrono::steady_clock::rep> now_{std::numeric_limits<std::chrono::steady_clock::rep>::min()};
+};
+
 struct ActionScore {
   sorry::Action action;
   double score;
+  // Number of games played through the action.
+  int visitCount;
 };
 
 class SorryMcts {
 public:
+  enum class NodeBudgetPolicy {
+    // Once the tree is full, iterations which would add a node play out from there instead, only refining the statistics already in the tree.
+    kStopExpanding,
+    // Once the tree is full, free the least visited subtrees to make room.
+    kRecycle
+  };
   explicit SorryMcts(double explorationConstant);
+  ~SorryMcts();
+  // Number of threads which search the shared tree concurrently during `run`. Must not be called while searching.
+  void setThreadCount(int threadCount);
+  // Run the extra search threads and pooled rollouts as tasks on `pool`, which must outlive the search, instead of on threads of our own; nullptr goes back to our own. Must not be called while searching.
+  void setThreadPool(ThreadPool *pool);
+  // Play `rolloutsPerLeaf` rollouts from every new leaf on `workerCount` threads, or on the pool from `setThreadPool`. Must not be called while searching.
+  void setLeafParallelism(int rolloutsPerLeaf, int workerCount);
+  // Share statistics between all occurrences of a position in roughly `maxBytes`, which also bounds the tree like a node budget does; 0 disables sharing. Must not be called while searching.
+  void setTranspositionTableSize(size_t maxBytes);
+  // Never keep more than `maxNodeCount` nodes in the tree. 0 means no limit. Must not be called while searching.
+  void setNodeBudget(size_t maxNodeCount, NodeBudgetPolicy policy);
+  // Let `run` return early once the remaining iterations could not change the most played action, which `pickBestAction` then picks. Must not be called while searching.
+  void setEarlyStopping(bool enabled);
+  // Search what the current player knows rather than the full state, redealing the opponents' hidden cards every iteration. Must not be called while searching.
+  void setInformationSetSearch(bool enabled);
+  // Only let a node try max(1, coefficient * visitCount^exponent) of its actions, most promising first; a coefficient of 0 disables widening. Must not be called while searching.
+  void setProgressiveWidening(double coefficient, double exponent);
+  // Blend in all-moves-as-first values, weighted by `equivalenceParameter`; 0 disables RAVE. Must not be called while searching.
+  void setRave(double equivalenceParameter);
+  // How rollouts pick their actions. `rolloutPolicy` must outlive the search; nullptr restores the default, which picks uniformly at random. Must not be called while searching.
+  void setRolloutPolicy(const RolloutPolicy *rolloutPolicy);
+  // Score rollouts with a static evaluator after `plyCount` actions; 0 plays them to the end. Must not be called while searching.
+  void setRolloutDepthLimit(int plyCount);
+  // Value the leaves that an EndgameSolver with these parameters accepts exactly, instead of rolling them out; 0 pieces disables it. Must not be called while searching.
+  void setEndgameSolver(int maxPiecesOutsideHome, int maxDistanceToHome, size_t nodeBudget);
+  // Score rollouts by `raceTablebase`, which must outlive the search, once they reach a race it covers; nullptr plays races out. Must not be called while searching.
+  void setRaceTablebase(const RaceTablebase *raceTablebase);
+  // Make searches with the same seed, thread count and iteration count build the same tree every time; nullopt seeds from the system again. Must not be called while searching.
+  void setSeed(std::optional<uint64_t> seed);
   void run(const sorry::Sorry &startingState, int rolloutCount);
   void run(const sorry::Sorry &startingState, std::chrono::duration<double> timeLimit);
+  // Each `run` keeps the part of the previous tree which is below `startingState`, if any. Stops pondering first.
   void run(const sorry::Sorry &startingState, internal::LoopCondition *loopCondition);
+  // Keep searching from `state`, the position after our action, on a background thread while the opponents decide. The next `run` stops it and continues from whichever of the searched positions the opponents actually led to. Settings must not be changed while pondering.
+  void startPondering(const sorry::Sorry &state, sorry::PlayerColor ourPlayer);
+  void stopPondering();
   void reset();
   sorry::Action pickBestAction() const;
+  // These three never wait for the search, so they are cheap to poll while it runs. During a search, the scores and win rates are as of at most `kIterationsPerSnapshot` iterations ago; afterwards, they are final.
   std::vector<ActionScore> getActionScores() const;
   std::vector<double> getWinRates() const;
   int getIterationCount() const;
+  // The virtual losses on every node of the tree, summed. Each iteration takes back the ones it adds, so this is 0 between searches.
+  float getVirtualLossTotal() const;
+  // What the most recent search, whether a `run` or pondering, did and where its time went.
+  SearchStats getSearchStats() const;
 private:
   const double explorationConstant_;
-  std::mt19937 eng_{0};
+  int threadCount_{1};
+  bool informationSetSearch_{false};
+  bool earlyStopping_{false};
+  double progressiveWideningCoefficient_{0};
+  double progressiveWideningExponent_{0};
+  double raveEquivalenceParameter_{0};
+  int rolloutsPerLeaf_{1};
+  const RolloutPolicy *rolloutPolicy_;
+  int rolloutDepthLimit_{0};
+  std::unique_ptr<ThreadPool> rolloutPool_;
+  ThreadPool *sharedPool_{nullptr};
+  std::unique_ptr<TranspositionTable<NodeStatistics>> transpositionTable_;
+  std::unique_ptr<EndgameSolver> endgameSolver_;
+  const RaceTablebase *raceTablebase_{nullptr};
   sorry::PlayerColor ourPlayer_;
+  std::optional<uint64_t> seed_;
 
-  mutable std::mutex treeMutex_;
+  size_t nodeBudget_{0};
+  NodeBudgetPolicy nodeBudgetPolicy_{NodeBudgetPolicy::kStopExpanding};
+
+  // Guards the lifetime of `rootNode_` and of nodes in the tree. Searching threads hold it shared for one iteration at a time and otherwise synchronize on a per-node basis. Only re-rooting, resetting and recycling take it exclusively.
+  mutable std::shared_mutex treeMutex_;
   Node *rootNode_{nullptr};
-  int iterationCount_;
-  void doSingleStep(const sorry::Sorry &startingState);
+  std::atomic<size_t> nodeCount_{0};
+  // Set when the tree is full and the node budget policy is to recycle. Searching threads stop starting iterations until it's cleared.
+  std::atomic<bool> recycleRequested_{false};
+
+  static constexpr int kIterationsPerSnapshot = 64;
+  // Only one thread publishes at a time.
+  std::mutex snapshotWriteMutex_;
+  std::unique_ptr<SeqLock<RootSnapshot>> rootSnapshot_;
+  // Publishes the statistics of the root for readers. If another thread is already publishing and `wait` is false, returns right away.
+  void publishRootSnapshot(bool wait);
+  std::atomic<int> iterationCount_{0};
+  mutable std::mutex searchStatsMutex_;
+  SearchStats searchStats_;
+  std::thread ponderThread_;
+  ExplicitTerminator ponderTerminator_;
+  // Makes the node for `state` the root, reusing it from the current tree if it's there.
+  void setRoot(const sorry::Sorry &state);
+  // Removes the node with `key` from the tree beneath the root and returns it, or nullptr if there is none. The caller must hold `treeMutex_`.
+  Node* detachDescendant(uint64_t key);
+  // Searches from the root, which must be `startingState`, until `loopCondition` says to stop. If `stopWhenDecided`, a root with a single action is searched only once, and with early stopping, the search ends once more iterations could not change the pick.
+  void search(const sorry::Sorry &startingState, internal::LoopCondition *loopCondition, bool stopWhenDecided);
+  // The part of `search` which runs in rounds, when there is a seed. Returns what the threads did.
+  SearchStats searchInRounds(const sorry::Sorry &startingState, internal::LoopCondition *loopCondition, bool forced, bool checkDecided);
+  static constexpr int kIterationsPerDecidedCheck = 64;
+  // Whether `remainingIterations` more iterations could not change which action is played most, which `pickBestAction` returns with early stopping.
+  bool rootIsDecided(int remainingIterations) const;
+  // The caller must hold `statistics.lock`, and some action must have been tried.
+  static size_t mostPlayedAction(const NodeStatistics &statistics);
+  void doSingleStep(const sorry::Sorry &startingState, std::mt19937 &eng, SearchStats &stats);
+  // The phases of `doSingleStep`. `descend` must be called with `treeMutex_` held shared; `playOut` doesn't touch the tree.
+  Descent descend(const sorry::Sorry &startingState, std::mt19937 &eng, SearchStats &stats);
+  // Positions the endgame solver solves go to `deferredEndgameSolutions` if given, instead of straight into its memo.
+  std::vector<Playout> playOut(const sorry::Sorry &state, std::mt19937 &eng, SearchStats &stats, EndgameSolver::Solutions *deferredEndgameSolutions);
+  // Information set search only. Picks among the actions which are legal in this determinization for an opponent, trying new ones first. Returns the action index and whether it is new.
+  std::pair<size_t, bool> selectAvailable(NodeStatistics &statistics, const sorry::Sorry &state, SearchStats &stats) const;
+  // Number of actions which the node is allowed to have tried, given how often it has been visited. The caller must hold `statistics.lock`.
+  size_t allowedChildCount(const NodeStatistics &statistics) const;
+  uint64_t keyOf(const sorry::Sorry &state) const;
+  // Returns nullptr if the transposition table has no room for new statistics, unless `isRoot`.
+  std::shared_ptr<NodeStatistics> statisticsFor(const sorry::Sorry &state, uint64_t key, SearchStats &stats, bool isRoot);
+  // Returns nullptr if the node budget does not allow a new successor.
+  Node* getOrCreateSuccessor(Node *node, size_t actionIndex, const sorry::Sorry &state, SearchStats &stats);
+  Node* nodeBudgetExhausted();
+  // Frees the least visited subtrees. Must be called without holding `treeMutex_`.
+  void recycleNodes(SearchStats &stats);
+  // Fills in the size of the tree as it is now.
+  void measureTree(SearchStats &stats) const;
 
-  // Returns the index of the action to take. This is one of the indices in the `indices` vector.
-  int select(const Node *currentNode, bool withExploration, const std::vector<size_t> &indices) const;
+  // Returns the index of the action to take. Only actions which have already been tried are considered. The caller must hold `statistics.lock`.
+  int select(const NodeStatistics &statistics, bool withExploration) const;
+  // Writes the score of each of the first `actionCount` actions to `scores`. The caller must hold `statistics.lock`.
+  void scoreActions(const NodeStatistics &statistics, size_t actionCount, bool withExploration, float *scores) const;
 
-  sorry::PlayerColor rollout(sorry::Sorry state);
-  void backprop(Node *current, sorry::PlayerColor winner);
-  double nodeScore(const Node *current, const Node *parent, bool withExploration) const;
+  Playout rollout(sorry::Sorry state, std::mt19937 &eng) const;
+  static Playout finishedPlayout(const sorry::Sorry &state);
+  // Plays `rolloutsPerLeaf_` rollouts.
+  std::vector<Playout> leafRollouts(const sorry::Sorry &state, std::mt19937 &eng);
+  void backprop(const std::vector<std::pair<NodeStatistics*, size_t>> &path, const std::vector<Playout> &playouts, SearchStats &stats);
   void printActions(const Node *current, int levels, int currentLevel=0) const;
 };
 
@@ -0,0 +1,45 @@
+#ifndef SPIN_LOCK_HPP_
+#define SPIN_LOCK_HPP_
+
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// A lock for critical sections which are only a handful of instructions long, where parking a thread in the kernel would cost far more than the wait. Satisfies Lockable, so it works with std::lock_guard and std::unique_lock.
+class SpinLock {
+public:
+  void lock() {
+    while (!try_lock()) {
+      // Spin on a plain load so that waiting threads do not keep stealing the cache line from the holder.
+      int spinCount = 0;
+      while (locked_.load(std::memory_order_relaxed)) {
+        if (++spinCount < kSpinsBeforeYield) {
+          pause();
+        } else {
+          // The holder was probably descheduled.
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+  bool try_lock() {
+    return !locked_.exchange(true, std::memory_order_acquire);
+  }
+  void unlock() {
+    locked_.store(false, std::memory_order_release);
+  }
+private:
+  static constexpr int kSpinsBeforeYield = 64;
+  std::atomic<bool> locked_{false};
+
+  static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+  }
+};
+
+#endif // SPIN_LOCK_HPP_
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "action.hpp"
+#include "sorry.hpp"
+#include "testing.hpp"
+
+#include <array>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+// Packs and unpacks every action generated along random games, and checks that each kind of action came up.
+void testPackRoundTripsGeneratedActions() {
+  std::mt19937 eng(42);
+  std::array<int, 5> countByType{};
+  const std::vector<std::vector<PlayerColor>> playerSets = {
+    {PlayerColor::kGreen, PlayerColor::kRed},
+    {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue},
+    {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue, PlayerColor::kYellow}
+  };
+  for (int gameIndex=0; gameIndex<60; ++gameIndex) {
+    Sorry state(playerSets[gameIndex % playerSets.size()]);
+    state.drawRandomStartingCards(eng);
+    while (!state.gameDone()) {
+      const auto actions = state.getActions();
+      for (const Action &action : actions) {
+        const uint32_t packed = action.pack();
+        CHECK(packed < (1u << 27));
+        const Action unpacked = Action::unpack(packed);
+        CHECK(unpacked == action);
+        CHECK(unpacked.pack() == packed);
+        ++countByType[static_cast<int>(action.actionType)];
+      }
+      // Distinct actions pack differently.
+      for (size_t i=0; i<actions.size(); ++i) {
+        for (size_t j=i+1; j<actions.size(); ++j) {
+          CHECK((actions[i] == actions[j]) == (actions[i].pack() == actions[j].pack()));
+        }
+      }
+      std::uniform_int_distribution<size_t> dist(0, actions.size()-1);
+      state.doAction(actions[dist(eng)], eng);
+    }
+  }
+  for (int count : countByType) {
+    CHECK(count > 0);
+  }
+}
+
+void testUnpackRejectsUnknownType() {
+  constexpr int kActionTypeShift = 2;
+  for (uint32_t type=5; type<8; ++type) {
+    bool threw = false;
+    try {
+      Action::unpack(type << kActionTypeShift);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    CHECK(threw);
+  }
+}
+
+} // namespace
+
+int main() {
+  testPackRoundTripsGeneratedActions();
+  testUnpackRejectsUnknownType();
+  return testing::testResult();
+}
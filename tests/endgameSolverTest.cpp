@@ -0,0 +1,162 @@
+#include "endgameSolver.hpp"
+#include "sorry.hpp"
+#include "testing.hpp"
+
+#include <array>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+constexpr double kTolerance = 1e-5;
+constexpr size_t kNodeBudget = 20000;
+
+// Plain max^n expectimax over every action and every card, without a memo or move ordering. Like the solver, gives up on lines of play which come back to a position on them, and on game trees of more than `maxNodeCount` positions, so that the test stays quick.
+class BruteForceExpectimax {
+public:
+  explicit BruteForceExpectimax(size_t maxNodeCount) : maxNodeCount_(maxNodeCount) {}
+
+  std::optional<std::array<double, 4>> value(const Sorry &state) {
+    if (state.gameDone()) {
+      return oneHot(state.getWinner());
+    }
+    const uint64_t key = state.hash();
+    if (++nodeCount_ > maxNodeCount_ || !line_.insert(key).second) {
+      return std::nullopt;
+    }
+    const int mover = static_cast<int>(state.getPlayerTurn());
+    const auto cardCounts = state.getFaceDownCardCounts();
+    int deckSize = 0;
+    for (const auto &[card, count] : cardCounts) {
+      deckSize += count;
+    }
+    std::optional<std::array<double, 4>> best;
+    for (const Action &action : state.getActions()) {
+      std::array<double, 4> expected{};
+      for (const auto &[card, count] : cardCounts) {
+        Sorry next = state;
+        next.doAction(action, card);
+        if (next.gameDone()) {
+          expected = oneHot(next.getWinner());
+          break;
+        }
+        const auto nextValue = value(next);
+        if (!nextValue) {
+          line_.erase(key);
+          return std::nullopt;
+        }
+        for (size_t i=0; i<expected.size(); ++i) {
+          expected[i] += static_cast<double>(count) / deckSize * (*nextValue)[i];
+        }
+      }
+      if (!best || expected[mover] > (*best)[mover]) {
+        best = expected;
+      }
+    }
+    line_.erase(key);
+    return best;
+  }
+private:
+  const size_t maxNodeCount_;
+  size_t nodeCount_{0};
+  std::unordered_set<uint64_t> line_;
+
+  static std::array<double, 4> oneHot(PlayerColor winner) {
+    std::array<double, 4> result{};
+    result[static_cast<int>(winner)] = 1;
+    return result;
+  }
+};
+
+// Two-player races with a piece or two each, close to home, for random deals of the hands. With two players every player's value follows from the mover's, so ties between actions cannot make the solver and brute force disagree.
+std::vector<Sorry> smallEndgames(std::mt19937 &eng, int count) {
+  std::vector<Sorry> result;
+  while (static_cast<int>(result.size()) < count) {
+    Sorry state({PlayerColor::kGreen, PlayerColor::kRed});
+    std::uniform_int_distribution<int> positionDist(61, 65);
+    state.setStartingPositions(PlayerColor::kGreen, {positionDist(eng), 66, 66, 66});
+    if (result.size() % 2 == 0) {
+      state.setStartingPositions(PlayerColor::kRed, {positionDist(eng), 66, 66, 66});
+    } else {
+      state.setStartingPositions(PlayerColor::kRed, {std::uniform_int_distribution<int>(61, 64)(eng), 65, 66, 66});
+    }
+    state.drawRandomStartingCards(eng);
+    state.setTurn(result.size() % 3 == 0 ? PlayerColor::kRed : PlayerColor::kGreen);
+    if (!state.gameDone()) {
+      result.push_back(state);
+    }
+  }
+  return result;
+}
+
+// The solver, with its memo, its move ordering and its cut-off at certain wins, values small endgames exactly like plain expectimax does, and within the same budget solves every one which plain expectimax can.
+void testSolverMatchesBruteForce() {
+  std::mt19937 eng(3);
+  EndgameSolver solver(4, 100, kNodeBudget);
+  int solvedCount = 0;
+  for (const Sorry &state : smallEndgames(eng, 100)) {
+    BruteForceExpectimax bruteForce(kNodeBudget);
+    const auto expected = bruteForce.value(state);
+    const auto solved = solver.solve(state);
+    if (!expected) {
+      continue;
+    }
+    // Every line of play ends within the budget, so nothing stops the solver either. The converse doesn't hold: the solver may skip a line which comes back on itself once it has found a certain win.
+    CHECK(solved.has_value());
+    if (!solved) {
+      continue;
+    }
+    ++solvedCount;
+    for (size_t i=0; i<expected->size(); ++i) {
+      CHECK(std::abs((*expected)[i] - (*solved)[i]) < kTolerance);
+    }
+  }
+  // Otherwise this would not test anything.
+  CHECK(solvedCount > 0);
+}
+
+// Deferred solutions stay out of the memo until they're remembered, and give the same values. A position which didn't fit in the budget is tried again once more is known.
+void testDeferredSolutions() {
+  std::mt19937 eng(4);
+  int retriedCount = 0;
+  for (const Sorry &state : smallEndgames(eng, 10)) {
+    EndgameSolver direct(4, 100, kNodeBudget);
+    EndgameSolver deferring(4, 100, kNodeBudget);
+    EndgameSolver::Solutions solutions;
+    const auto directValue = direct.solve(state);
+    const auto deferredValue = deferring.solve(state, &solutions);
+    CHECK(directValue.has_value() == deferredValue.has_value());
+    if (!directValue || !deferredValue) {
+      continue;
+    }
+    CHECK(*directValue == *deferredValue);
+    CHECK(!solutions.empty());
+    // Nothing was remembered, so solving again finds everything again.
+    EndgameSolver::Solutions again;
+    deferring.solve(state, &again);
+    CHECK(again.size() == solutions.size());
+    // A budget of a single position only fits if every action ends the game, but once the solutions are remembered, nothing needs expanding.
+    EndgameSolver tiny(4, 100, 1);
+    EndgameSolver::Solutions unused;
+    if (!tiny.solve(state, &unused)) {
+      ++retriedCount;
+    }
+    tiny.remember(solutions);
+    const auto remembered = tiny.solve(state);
+    CHECK(remembered.has_value() && *remembered == *directValue);
+  }
+  CHECK(retriedCount > 0);
+}
+
+} // namespace
+
+int main() {
+  testSolverMatchesBruteForce();
+  testDeferredSolutions();
+  return testing::testResult();
+}
@@ -0,0 +1,99 @@
+#include "expectimaxSearch.hpp"
+#include "heuristics.hpp"
+#include "sorry.hpp"
+#include "testing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+constexpr double kTolerance = 1e-9;
+
+// Plain expectimax over every action and every card, without any pruning, with the same leaf values and paranoid opponents as ExpectimaxSearch.
+class UnprunedExpectimax {
+public:
+  explicit UnprunedExpectimax(PlayerColor ourPlayer) : ourPlayer_(ourPlayer) {}
+
+  double decisionValue(const Sorry &state, int depth) const {
+    if (state.gameDone()) {
+      return (state.getWinner() == ourPlayer_ ? 1 : 0);
+    }
+    if (depth == 0) {
+      return evaluatePosition(state)[static_cast<int>(ourPlayer_)];
+    }
+    const bool maximizing = (state.getPlayerTurn() == ourPlayer_);
+    double best = (maximizing ? 0 : 1);
+    for (const Action &action : state.getActions()) {
+      const double value = chanceValue(state, action, depth);
+      best = (maximizing ? std::max(best, value) : std::min(best, value));
+    }
+    return best;
+  }
+
+  double chanceValue(const Sorry &state, const Action &action, int depth) const {
+    const auto cardCounts = state.getFaceDownCardCounts();
+    int deckSize = 0;
+    for (const auto &[card, count] : cardCounts) {
+      deckSize += count;
+    }
+    double value = 0;
+    for (const auto &[card, count] : cardCounts) {
+      Sorry next = state;
+      next.doAction(action, card);
+      if (next.gameDone()) {
+        return (next.getWinner() == ourPlayer_ ? 1 : 0);
+      }
+      value += static_cast<double>(count) / deckSize * decisionValue(next, depth-1);
+    }
+    return value;
+  }
+private:
+  const PlayerColor ourPlayer_;
+};
+
+// Searches positions from seeded random games of two and three players to depths 1 to 3, and checks that the pruned search finds the same value as the unpruned one, and picks an action which really has that value.
+void testPruningKeepsValues() {
+  std::mt19937 eng(7);
+  int comparedCount = 0;
+  for (int gameIndex=0; gameIndex<12; ++gameIndex) {
+    std::vector<PlayerColor> players = {PlayerColor::kGreen, PlayerColor::kRed};
+    if (gameIndex % 3 == 2) {
+      players.push_back(PlayerColor::kBlue);
+    }
+    Sorry state(players);
+    state.drawRandomStartingCards(eng);
+    const int moveCount = 20 + eng() % 60;
+    for (int moveIndex=0; moveIndex<moveCount && !state.gameDone(); ++moveIndex) {
+      const auto actions = state.getActions();
+      state.doAction(actions[eng() % actions.size()], eng);
+    }
+    if (state.gameDone() || state.getActions().size() < 2) {
+      continue;
+    }
+    const UnprunedExpectimax unpruned(state.getPlayerTurn());
+    for (int depth=1; depth<=3; ++depth) {
+      double bestValue = 0;
+      for (const Action &action : state.getActions()) {
+        bestValue = std::max(bestValue, unpruned.chanceValue(state, action, depth));
+      }
+      ExpectimaxSearch search;
+      const ExpectimaxSearch::Result result = search.search(state, depth, std::nullopt);
+      CHECK(std::abs(result.value - bestValue) < kTolerance);
+      CHECK(std::abs(unpruned.chanceValue(state, result.bestAction, depth) - bestValue) < kTolerance);
+      ++comparedCount;
+    }
+  }
+  CHECK(comparedCount >= 15);
+}
+
+} // namespace
+
+int main() {
+  testPruningKeepsValues();
+  return testing::testResult();
+}
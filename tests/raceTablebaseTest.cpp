@@ -0,0 +1,101 @@
+#include "endgameSolver.hpp"
+#include "raceTablebase.hpp"
+#include "sorry.hpp"
+#include "testing.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+const std::string kTablePath = "raceTablebaseTest.bin";
+
+// The header's side count and the first values are stored little-endian whatever the host.
+void testFileIsLittleEndian() {
+  std::ifstream input(kTablePath, std::ios::binary);
+  const std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+  CHECK(bytes.size() > 24);
+  if (bytes.size() <= 24) {
+    return;
+  }
+  CHECK(std::string(bytes.begin(), bytes.begin()+8) == "SRYRACE1");
+  // 31 sides.
+  CHECK(bytes[8] == 31 && bytes[9] == 0 && bytes[10] == 0 && bytes[11] == 0);
+  // A mover with every piece home has won, even against an opponent likewise home, which can't happen: 0.0f, then 1.0f.
+  CHECK(bytes[16] == 0 && bytes[17] == 0 && bytes[18] == 0 && bytes[19] == 0);
+  CHECK(bytes[20] == 0 && bytes[21] == 0 && bytes[22] == 0x80 && bytes[23] == 0x3F);
+}
+
+// Solves races with one piece each exactly for many deals of the hands, and compares the average to the table. Single deals are nearly always won or lost outright, and the table's hands are drawn fresh from a full deck each turn, so only the average over deals is comparable, and only roughly.
+void testProbeAgreesWithEndgameSolver() {
+  constexpr int kDealCount = 60;
+  constexpr double kTolerance = 0.1;
+  const RaceTablebase table(kTablePath);
+  std::mt19937 eng(5);
+  // Green, to move, and red's piece positions.
+  const std::vector<std::array<int, 2>> races = {{61, 65}, {64, 62}};
+  for (const auto &[greenPosition, redPosition] : races) {
+    // Deals which would take longer are left out.
+    EndgameSolver solver(2, 10, 200000);
+    double solvedSum = 0;
+    int solvedCount = 0;
+    float tableValue = 0;
+    for (int deal=0; deal<kDealCount; ++deal) {
+      Sorry state({PlayerColor::kGreen, PlayerColor::kRed});
+      state.setStartingPositions(PlayerColor::kGreen, {greenPosition, 66, 66, 66});
+      state.setStartingPositions(PlayerColor::kRed, {redPosition, 66, 66, 66});
+      state.drawRandomStartingCards(eng);
+      state.setTurn(PlayerColor::kGreen);
+      const auto probed = table.probe(state);
+      CHECK(probed.has_value());
+      if (!probed) {
+        return;
+      }
+      tableValue = (*probed)[static_cast<int>(PlayerColor::kGreen)];
+      CHECK(std::abs((*probed)[static_cast<int>(PlayerColor::kGreen)] + (*probed)[static_cast<int>(PlayerColor::kRed)] - 1) < 1e-6);
+      if (const auto solved = solver.solve(state)) {
+        solvedSum += (*solved)[static_cast<int>(PlayerColor::kGreen)];
+        ++solvedCount;
+      }
+    }
+    CHECK(solvedCount >= kDealCount/2);
+    if (solvedCount == 0) {
+      continue;
+    }
+    const double solvedValue = solvedSum / solvedCount;
+    CHECK(std::abs(solvedValue - tableValue) < kTolerance);
+  }
+}
+
+void testProbeRejectsNonRaces() {
+  const RaceTablebase table(kTablePath);
+  std::mt19937 eng(5);
+  Sorry started({PlayerColor::kGreen, PlayerColor::kRed});
+  started.drawRandomStartingCards(eng);
+  CHECK(!table.probe(started).has_value());
+  Sorry threePlayers({PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue});
+  for (PlayerColor color : {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue}) {
+    threePlayers.setStartingPositions(color, {64, 66, 66, 66});
+  }
+  threePlayers.drawRandomStartingCards(eng);
+  CHECK(!table.probe(threePlayers).has_value());
+}
+
+} // namespace
+
+int main() {
+  RaceTablebase::generate(kTablePath, 1);
+  testFileIsLittleEndian();
+  testProbeAgreesWithEndgameSolver();
+  testProbeRejectsNonRaces();
+  std::remove(kTablePath.c_str());
+  return testing::testResult();
+}
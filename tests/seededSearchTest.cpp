@@ -0,0 +1,94 @@
+#include "sorry.hpp"
+#include "sorryMcts.hpp"
+#include "testing.hpp"
+#include "threadPool.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+struct SearchResult {
+  Action bestAction;
+  std::vector<ActionScore> actionScores;
+  uint64_t endgameSolvedCount;
+};
+
+SearchResult searchOnce(const Sorry &state, uint64_t seed, int threadCount, ThreadPool *pool, int iterationCount = 2000, bool withEndgameSolver = false) {
+  SorryMcts mcts(2.0);
+  mcts.setThreadCount(threadCount);
+  mcts.setThreadPool(pool);
+  mcts.setSeed(seed);
+  if (withEndgameSolver) {
+    mcts.setEndgameSolver(2, 12, 300);
+  }
+  mcts.run(state, iterationCount);
+  return {mcts.pickBestAction(), mcts.getActionScores(), mcts.getSearchStats().endgameSolvedCount};
+}
+
+void checkSameResult(const SearchResult &lhs, const SearchResult &rhs) {
+  CHECK(lhs.bestAction == rhs.bestAction);
+  CHECK(lhs.actionScores.size() == rhs.actionScores.size());
+  for (size_t i=0; i<lhs.actionScores.size() && i<rhs.actionScores.size(); ++i) {
+    CHECK(lhs.actionScores[i].action == rhs.actionScores[i].action);
+    CHECK(lhs.actionScores[i].visitCount == rhs.actionScores[i].visitCount);
+  }
+}
+
+// Searches positions from a few random games twice with the same seed, on several threads of their own or of a pool, and checks that both searches agree.
+void testSameSeedGivesSameSearch() {
+  std::mt19937 eng(7);
+  ThreadPool pool(3);
+  for (int gameIndex=0; gameIndex<3; ++gameIndex) {
+    Sorry state({PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue});
+    state.drawRandomStartingCards(eng);
+    // Some way into the game, so that pieces are out on the board.
+    for (int moveIndex=0; moveIndex<10*gameIndex && !state.gameDone(); ++moveIndex) {
+      const auto actions = state.getActions();
+      std::uniform_int_distribution<size_t> dist(0, actions.size()-1);
+      state.doAction(actions[dist(eng)], eng);
+    }
+    if (state.gameDone()) {
+      continue;
+    }
+    for (ThreadPool *searchPool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+      const uint64_t seed = 1000 + gameIndex;
+      checkSameResult(searchOnce(state, seed, 4, searchPool), searchOnce(state, seed, 4, searchPool));
+    }
+  }
+}
+
+// Likewise near the end of two-player games, where the endgame solver values many leaves, and whether it manages to within its budget depends on what it has solved before.
+void testSameSeedGivesSameSearchWithEndgameSolver() {
+  std::mt19937 eng(9);
+  ThreadPool pool(3);
+  uint64_t endgameSolvedCount = 0;
+  for (int gameIndex=0; gameIndex<2; ++gameIndex) {
+    Sorry state({PlayerColor::kGreen, PlayerColor::kRed});
+    std::uniform_int_distribution<int> positionDist(58, 64);
+    state.setStartingPositions(PlayerColor::kGreen, {positionDist(eng), 65, 66, 66});
+    state.setStartingPositions(PlayerColor::kRed, {positionDist(eng), 66, 66, 66});
+    state.drawRandomStartingCards(eng);
+    if (state.gameDone() || state.getActions().size() < 2) {
+      continue;
+    }
+    for (ThreadPool *searchPool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+      const uint64_t seed = 2000 + gameIndex;
+      const SearchResult first = searchOnce(state, seed, 4, searchPool, /*iterationCount=*/500, /*withEndgameSolver=*/true);
+      checkSameResult(first, searchOnce(state, seed, 4, searchPool, /*iterationCount=*/500, /*withEndgameSolver=*/true));
+      endgameSolvedCount += first.endgameSolvedCount;
+    }
+  }
+  // Otherwise this would not test anything.
+  CHECK(endgameSolvedCount > 0);
+}
+
+} // namespace
+
+int main() {
+  testSameSeedGivesSameSearch();
+  testSameSeedGivesSameSearchWithEndgameSolver();
+  return testing::testResult();
+}
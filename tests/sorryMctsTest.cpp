@@ -0,0 +1,220 @@
+#include "sorry.hpp"
+#include "sorryMcts.hpp"
+#include "testing.hpp"
+#include "threadPool.hpp"
+#include "transpositionTable.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace sorry;
+
+namespace {
+
+// A position some way into a random game, so that pieces are out on the board and there is something to decide.
+Sorry midgamePosition(std::mt19937 &eng, const std::vector<PlayerColor> &players, int moveCount) {
+  while (true) {
+    Sorry state(players);
+    state.drawRandomStartingCards(eng);
+    for (int moveIndex=0; moveIndex<moveCount && !state.gameDone(); ++moveIndex) {
+      const auto actions = state.getActions();
+      std::uniform_int_distribution<size_t> dist(0, actions.size()-1);
+      state.doAction(actions[dist(eng)], eng);
+    }
+    if (!state.gameDone() && state.getActions().size() > 1) {
+      return state;
+    }
+  }
+}
+
+// Threads racing for the last iterations must not run more than asked for, and must take back every virtual loss they added.
+void testIterationCountIsExact() {
+  std::mt19937 eng(11);
+  ThreadPool pool(3);
+  for (int iterationCount : {1, 7, 997}) {
+    for (ThreadPool *searchPool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+      const Sorry state = midgamePosition(eng, {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue}, 12);
+      SorryMcts mcts(2.0);
+      mcts.setThreadCount(4);
+      mcts.setThreadPool(searchPool);
+      mcts.run(state, iterationCount);
+      CHECK(mcts.getIterationCount() == iterationCount);
+      int visitCount = 0;
+      for (const ActionScore &actionScore : mcts.getActionScores()) {
+        visitCount += actionScore.visitCount;
+      }
+      CHECK(visitCount == iterationCount);
+      CHECK(mcts.getVirtualLossTotal() == 0);
+    }
+  }
+}
+
+// Racing threads must not take the tree past its node budget, whether it stops growing there or recycles.
+void testNodeBudgetIsRespected() {
+  constexpr size_t kNodeBudget = 200;
+  std::mt19937 eng(13);
+  for (auto policy : {SorryMcts::NodeBudgetPolicy::kStopExpanding, SorryMcts::NodeBudgetPolicy::kRecycle}) {
+    SorryMcts mcts(2.0);
+    mcts.setThreadCount(4);
+    mcts.setNodeBudget(kNodeBudget, policy);
+    Sorry state = midgamePosition(eng, {PlayerColor::kGreen, PlayerColor::kRed}, 6);
+    // Several moves of a game, so that trees kept from the previous move are covered too.
+    for (int moveIndex=0; moveIndex<4 && !state.gameDone(); ++moveIndex) {
+      mcts.run(state, 2000);
+      const SearchStats stats = mcts.getSearchStats();
+      CHECK(stats.peakTreeNodeCount <= kNodeBudget);
+      CHECK(stats.treeNodeCount <= stats.peakTreeNodeCount);
+      if (policy == SorryMcts::NodeBudgetPolicy::kRecycle) {
+        CHECK(stats.nodesRecycled > 0);
+      } else {
+        CHECK(stats.nodesRecycled == 0);
+      }
+      state.doAction(mcts.pickBestAction(), eng);
+    }
+  }
+}
+
+// A seeded search which stops early is the start of the same search run to the end, and it may only stop once that search could not end up playing another action more.
+void testEarlyStoppingKeepsTheMostPlayedAction() {
+  constexpr int kIterationCount = 3000;
+  std::mt19937 eng(19);
+  int stoppedEarlyCount = 0;
+  for (int positionIndex=0; positionIndex<4; ++positionIndex) {
+    const Sorry state = midgamePosition(eng, {PlayerColor::kGreen, PlayerColor::kRed}, 4 + 4*positionIndex);
+    auto makeSearch = [](bool earlyStopping) {
+      auto mcts = std::make_unique<SorryMcts>(2.0);
+      mcts->setThreadCount(2);
+      mcts->setSeed(23);
+      mcts->setEarlyStopping(earlyStopping);
+      return mcts;
+    };
+    auto stopped = makeSearch(true);
+    stopped->run(state, kIterationCount);
+    auto full = makeSearch(false);
+    full->run(state, kIterationCount);
+    if (stopped->getIterationCount() < kIterationCount) {
+      ++stoppedEarlyCount;
+    }
+    const auto scores = full->getActionScores();
+    const auto mostPlayed = std::max_element(scores.begin(), scores.end(), [](const ActionScore &lhs, const ActionScore &rhs) {
+      return lhs.visitCount < rhs.visitCount;
+    });
+    CHECK(mostPlayed != scores.end());
+    if (mostPlayed == scores.end()) {
+      continue;
+    }
+    CHECK(stopped->pickBestAction() == mostPlayed->action);
+    // No other action even ties.
+    CHECK(std::count_if(scores.begin(), scores.end(), [&](const ActionScore &score) {
+      return score.visitCount == mostPlayed->visitCount;
+    }) == 1);
+  }
+  // Otherwise this would not test anything.
+  CHECK(stoppedEarlyCount > 0);
+}
+
+// Finds the action of `state` which plays `card` on piece `pieceIndex`, or discards `card` if `pieceIndex` is negative.
+Action findAction(const Sorry &state, Card card, int pieceIndex) {
+  const auto actions = state.getActions();
+  const auto it = std::find_if(actions.begin(), actions.end(), [&](const Action &action) {
+    if (action.card != card) {
+      return false;
+    }
+    if (pieceIndex < 0) {
+      return action.actionType == Action::ActionType::kDiscard;
+    }
+    return action.actionType == Action::ActionType::kSingleMove && action.piece1Index == pieceIndex;
+  });
+  if (it == actions.end()) {
+    throw std::runtime_error("Expected action is not legal");
+  }
+  return *it;
+}
+
+struct CountedValue {
+  float gameCount() const { return 0; }
+};
+
+// Green moves two pieces with a 3 and a 5 in either order while Red, stuck in start, discards. Both orders lead to the same position, which must get a single entry. A search with a transposition table then also shares statistics between nodes.
+void testTranspositionsShareStatistics() {
+  Sorry start({PlayerColor::kGreen, PlayerColor::kRed});
+  start.setStartingPositions(PlayerColor::kGreen, {8, 24, 0, 0});
+  start.setStartingPositions(PlayerColor::kRed, {0, 0, 0, 0});
+  start.setStartingCards(PlayerColor::kGreen, {Card::kThree, Card::kFive, Card::kEight, Card::kEight, Card::kTwelve});
+  start.setStartingCards(PlayerColor::kRed, {Card::kThree, Card::kFour, Card::kFive, Card::kSeven, Card::kEight});
+  start.setTurn(PlayerColor::kGreen);
+  auto play = [](Sorry state, Card firstCard, int firstPiece, Card secondCard, int secondPiece) {
+    state.doAction(findAction(state, firstCard, firstPiece), Card::kTen);
+    state.doAction(findAction(state, Card::kThree, -1), Card::kTen);
+    state.doAction(findAction(state, secondCard, secondPiece), Card::kEleven);
+    state.doAction(findAction(state, Card::kFour, -1), Card::kEleven);
+    return state;
+  };
+  const Sorry threeFirst = play(start, Card::kThree, 0, Card::kFive, 1);
+  const Sorry fiveFirst = play(start, Card::kFive, 1, Card::kThree, 0);
+  CHECK(threeFirst.hash() == fiveFirst.hash());
+  CHECK(threeFirst.hash() != start.hash());
+
+  TranspositionTable<CountedValue> table(64);
+  int createCount = 0;
+  auto create = [&]() {
+    ++createCount;
+    return std::make_shared<CountedValue>();
+  };
+  const auto threeFirstValue = table.findOrInsert(threeFirst.hash(), create);
+  const auto fiveFirstValue = table.findOrInsert(fiveFirst.hash(), create);
+  CHECK(threeFirstValue != nullptr && threeFirstValue == fiveFirstValue);
+  CHECK(createCount == 1);
+
+  std::mt19937 eng(3);
+  const Sorry state = midgamePosition(eng, {PlayerColor::kGreen, PlayerColor::kRed}, 10);
+  SorryMcts mcts(2.0);
+  mcts.setSeed(1);
+  mcts.run(state, 5000);
+  const SearchStats unsharedStats = mcts.getSearchStats();
+  CHECK(unsharedStats.statisticsAllocated >= unsharedStats.nodesAllocated);
+  mcts.reset();
+  mcts.setTranspositionTableSize(64 << 20);
+  mcts.run(state, 5000);
+  const SearchStats sharedStats = mcts.getSearchStats();
+  CHECK(sharedStats.statisticsAllocated < sharedStats.nodesAllocated);
+}
+
+// In information set search, we must not peek: with the same seed, a position whose opponents hold other hidden cards must be searched exactly the same way, down to the visit counts.
+void testInformationSetSearchIgnoresHiddenCards() {
+  std::mt19937 eng(5);
+  for (int positionIndex=0; positionIndex<4; ++positionIndex) {
+    const Sorry state = midgamePosition(eng, {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue}, 8 + 4*positionIndex);
+    Sorry redealt = state;
+    redealt.randomizeHiddenInformation(state.getPlayerTurn(), eng);
+    auto search = [](const Sorry &searched) {
+      SorryMcts mcts(2.0);
+      mcts.setInformationSetSearch(true);
+      mcts.setThreadCount(2);
+      mcts.setSeed(17);
+      mcts.run(searched, 1000);
+      return mcts.getActionScores();
+    };
+    const auto scores = search(state);
+    const auto redealtScores = search(redealt);
+    CHECK(scores.size() == redealtScores.size());
+    for (size_t i=0; i<scores.size() && i<redealtScores.size(); ++i) {
+      CHECK(scores[i].action == redealtScores[i].action);
+      CHECK(scores[i].visitCount == redealtScores[i].visitCount);
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  testIterationCountIsExact();
+  testNodeBudgetIsRespected();
+  testEarlyStoppingKeepsTheMostPlayedAction();
+  testTranspositionsShareStatistics();
+  testInformationSetSearchIgnoresHiddenCards();
+  return testing::testResult();
+}
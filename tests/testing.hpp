@@ -0,0 +1,33 @@
+#ifndef TESTING_HPP_
+#define TESTING_HPP_
+
+#include <iostream>
+
+// Minimal checks for the test executables. A failed CHECK reports where it failed and lets the test go on; the test's main returns testResult() so that ctest sees any failure.
+
+namespace testing {
+
+inline int &failureCount() {
+  static int count = 0;
+  return count;
+}
+
+inline int testResult() {
+  if (failureCount() > 0) {
+    std::cerr << failureCount() << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace testing
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+      ++testing::failureCount(); \
+    } \
+  } while (false)
+
+#endif // TESTING_HPP_
@@ -0,0 +1,134 @@
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// The pool and worker index of the calling thread, if it is a worker.
+thread_local const ThreadPool *currentWorkerPool = nullptr;
+thread_local int currentWorkerIndex = -1;
+
+void pinCurrentThread(int workerIndex) {
+#ifdef __linux__
+  const unsigned int coreCount = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(workerIndex % coreCount, &cpuSet);
+  // Best effort; an unpinned worker still works.
+  pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+  (void)workerIndex;
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(int threadCount, bool pinThreads) {
+  if (threadCount < 1) {
+    throw std::runtime_error("Thread pool needs at least one thread");
+  }
+  workerQueues_.reserve(threadCount);
+  for (int i=0; i<threadCount; ++i) {
+    workerQueues_.push_back(std::make_unique<TaskQueue>());
+  }
+  workers_.reserve(threadCount);
+  for (int i=0; i<threadCount; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i, pinThreads);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock lock(sleepMutex_);
+    stopping_ = true;
+  }
+  taskAvailable_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+int ThreadPool::threadCount() const {
+  return workers_.size();
+}
+
+const ThreadPool* ThreadPool::currentPool() {
+  return currentWorkerPool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+  TaskQueue &queue = (currentWorkerPool == this ? *workerQueues_[currentWorkerIndex] : sharedQueue_);
+  {
+    std::unique_lock lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  ++queuedTaskCount_;
+  {
+    // Taking the lock orders this with a worker which has just seen no tasks and is about to sleep.
+    std::unique_lock lock(sleepMutex_);
+  }
+  taskAvailable_.notify_one();
+}
+
+bool ThreadPool::runPendingTask(bool ownQueueOnly) {
+  if (queuedTaskCount_ == 0) {
+    return false;
+  }
+  std::function<void()> task;
+  auto takeFrom = [&](TaskQueue &queue, bool newest) {
+    std::unique_lock lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      return false;
+    }
+    if (newest) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  };
+  const bool isWorker = (currentWorkerPool == this);
+  const int queueCount = workerQueues_.size();
+  // Newest first from our own queue, since its data is most likely still in cache; oldest first from everyone else's, since older tasks tend to be bigger.
+  bool found = (isWorker && takeFrom(*workerQueues_[currentWorkerIndex], /*newest=*/true)) || (!ownQueueOnly && takeFrom(sharedQueue_, /*newest=*/false));
+  const int firstVictim = (isWorker ? currentWorkerIndex+1 : 0);
+  for (int i=0; !found && !ownQueueOnly && i<queueCount; ++i) {
+    const int victim = (firstVictim + i) % queueCount;
+    if (isWorker && victim == currentWorkerIndex) {
+      continue;
+    }
+    found = takeFrom(*workerQueues_[victim], /*newest=*/false);
+  }
+  if (!found) {
+    return false;
+  }
+  --queuedTaskCount_;
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(int workerIndex, bool pinThread) {
+  currentWorkerPool = this;
+  currentWorkerIndex = workerIndex;
+  if (pinThread) {
+    pinCurrentThread(workerIndex);
+  }
+  while (true) {
+    if (runPendingTask()) {
+      continue;
+    }
+    std::unique_lock lock(sleepMutex_);
+    taskAvailable_.wait(lock, [this]() { return stopping_ || queuedTaskCount_ > 0; });
+    if (stopping_ && queuedTaskCount_ == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads which share the tasks submitted to them by work stealing.
+//
+// Tasks submitted from outside the pool go into a shared queue and start in the order submitted. Tasks submitted by a task running on a worker go onto that worker's own queue, which it works through newest first while idle workers steal from it oldest first. This keeps nested parallelism, like a game on the pool whose search also runs on the pool, from needing more threads than cores.
+class ThreadPool {
+public:
+  // If `pinThreads`, worker i is restricted to core i modulo the number of cores, where the platform allows it.
+  explicit ThreadPool(int threadCount, bool pinThreads = false);
+  // Runs every task already submitted, then stops the workers.
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int threadCount() const;
+
+  template<typename Function>
+  auto submit(Function &&function) -> std::future<decltype(function())> {
+    using ResultType = decltype(function());
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Function>(function));
+    std::future<ResultType> result = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // Returns the result of `future`. On a worker of this pool, runs the tasks on the worker's own queue while it isn't ready: the ones it submitted itself and not yet handed out, among which is anything the awaited task is blocked on that nobody has stolen. It never takes tasks from the shared queue or other workers, so a waiting game's search doesn't end up running other whole games on its stack. Tasks which wait for tasks they submitted should wait this way, so that they don't hold a worker idle, which could deadlock a small pool.
+  template<typename T>
+  T wait(std::future<T> &future) {
+    if (currentPool() != this) {
+      // Nothing of ours to run; what we submitted is in the shared queue, for the workers.
+      return future.get();
+    }
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      if (!runPendingTask(/*ownQueueOnly=*/true)) {
+        // Nothing to help with; whatever we wait for is running elsewhere.
+        future.wait_for(kIdleWaitTime);
+      }
+    }
+    return future.get();
+  }
+private:
+  static constexpr std::chrono::microseconds kIdleWaitTime{50};
+  // Padded to a cache line so that workers locking neighboring queues don't contend.
+  struct alignas(64) TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<TaskQueue>> workerQueues_;
+  TaskQueue sharedQueue_;
+  // Tasks in any queue. Idle workers sleep while it is 0.
+  std::atomic<int> queuedTaskCount_{0};
+  std::mutex sleepMutex_;
+  std::condition_variable taskAvailable_;
+  bool stopping_{false};
+  void enqueue(std::function<void()> task);
+  // Takes a task, in order of preference from the calling worker's own queue, the shared queue, or another worker's queue, and runs it. With `ownQueueOnly`, only from the calling worker's own queue. Returns false if there was none.
+  bool runPendingTask(bool ownQueueOnly = false);
+  // The pool whose worker the calling thread is, if any.
+  static const ThreadPool* currentPool();
+  void workerLoop(int workerIndex, bool pinThread);
+};
+
+#endif // THREAD_POOL_HPP_
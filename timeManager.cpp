@@ -0,0 +1,36 @@
+#include "sorry.hpp"
+#include "timeManager.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Average number of squares that a player's pieces advance in one of their turns, counting turns wasted on discards and being sent back.
+constexpr double kSquaresPerTurn = 4.0;
+// Never plan for fewer moves than this, since the estimate is rough and the game can drag on.
+constexpr double kMinimumMovesLeft = 6.0;
+// Part of the remaining time which is never handed out.
+constexpr double kReserveFraction = 0.05;
+
+} // namespace
+
+TimeManager::TimeManager(std::chrono::duration<double> gameTime) : remaining_(gameTime) {}
+
+std::chrono::duration<double> TimeManager::budgetFor(const sorry::Sorry &state) const {
+  const sorry::PlayerColor us = state.getPlayerTurn();
+  int distanceLeft = 0;
+  for (int position : state.getPiecePositionsForPlayer(us)) {
+    distanceLeft += state.distanceToHome(us, position);
+  }
+  const double movesLeft = std::max(kMinimumMovesLeft, distanceLeft / kSquaresPerTurn);
+  const double available = std::max(0.0, remaining_.count() * (1.0 - kReserveFraction));
+  return std::chrono::duration<double>(available / movesLeft);
+}
+
+void TimeManager::spend(std::chrono::duration<double> used) {
+  remaining_ -= used;
+}
+
+std::chrono::duration<double> TimeManager::remaining() const {
+  return remaining_;
+}
@@ -0,0 +1,23 @@
+#ifndef TIME_MANAGER_HPP_
+#define TIME_MANAGER_HPP_
+
+#include <chrono>
+
+namespace sorry {
+class Sorry;
+} // namespace sorry
+
+// Splits the time we have for a whole game into a budget for each of our moves.
+class TimeManager {
+public:
+  explicit TimeManager(std::chrono::duration<double> gameTime);
+  // How long to think about `state`, in which it's our turn. Spends more while many moves remain to be made and keeps a reserve so that the clock never runs out.
+  std::chrono::duration<double> budgetFor(const sorry::Sorry &state) const;
+  // Charges `used` to the clock.
+  void spend(std::chrono::duration<double> used);
+  std::chrono::duration<double> remaining() const;
+private:
+  std::chrono::duration<double> remaining_;
+};
+
+#endif // TIME_MANAGER_HPP_
@@ -0,0 +1,145 @@
+#include "common.hpp"
+#include "sorry.hpp"
+#include "threadPool.hpp"
+#include "tournament.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+using namespace sorry;
+
+namespace {
+
+constexpr std::array<PlayerColor, 4> kColors = {PlayerColor::kGreen, PlayerColor::kRed, PlayerColor::kBlue, PlayerColor::kYellow};
+
+// Plays game number `gameIndex` and returns the index of the winning entry. If `statsLines` isn't null, appends a line of search statistics to it for every move.
+size_t playGame(const TournamentConfig &config, int gameIndex, ThreadPool &pool, std::string *statsLines) {
+  const size_t entryCount = config.entries.size();
+  // Cycle through every seat rotation, then shift which colors are used.
+  const size_t seatRotation = gameIndex % entryCount;
+  const size_t colorRotation = (gameIndex / entryCount) % kColors.size();
+  std::vector<PlayerColor> colors;
+  std::array<size_t, 4> entryIndexOfColor{};
+  std::vector<std::unique_ptr<BaseAgent>> agents(entryCount);
+  for (size_t seat=0; seat<entryCount; ++seat) {
+    const PlayerColor color = kColors[(seat + colorRotation) % kColors.size()];
+    const size_t entryIndex = (seat + seatRotation) % entryCount;
+    colors.push_back(color);
+    entryIndexOfColor[static_cast<int>(color)] = entryIndex;
+    agents[entryIndex] = config.entries[entryIndex].create(pool);
+  }
+  std::mt19937 eng = createRandomEngine();
+  Sorry sorry(colors);
+  sorry.drawRandomStartingCards(eng);
+  for (int moveIndex=0; !sorry.gameDone(); ++moveIndex) {
+    const PlayerColor color = sorry.getPlayerTurn();
+    const size_t entryIndex = entryIndexOfColor[static_cast<int>(color)];
+    const Action action = agents[entryIndex]->getAction(sorry);
+    if (statsLines != nullptr) {
+      if (const auto stats = agents[entryIndex]->lastSearchStats()) {
+        std::stringstream ss;
+        ss << "{\"game\":" << gameIndex << ",\"move\":" << moveIndex << ",\"color\":\"" << toString(color) << "\",\"entry\":\"" << config.entries[entryIndex].name << "\",\"stats\":" << stats->toJson() << "}\n";
+        *statsLines += ss.str();
+      }
+    }
+    sorry.doAction(action, eng);
+  }
+  return entryIndexOfColor[static_cast<int>(sorry.getWinner())];
+}
+
+} // namespace
+
+double TournamentEntryResult::winRate() const {
+  if (gameCount == 0) {
+    return 0;
+  }
+  return static_cast<double>(winCount) / gameCount;
+}
+
+std::pair<double, double> TournamentEntryResult::confidenceInterval() const {
+  return wilsonInterval(winCount, gameCount);
+}
+
+double TournamentResult::gamesPerSecond() const {
+  if (wallSeconds == 0) {
+    return 0;
+  }
+  return gameCount / wallSeconds;
+}
+
+std::string TournamentResult::toString() const {
+  std::stringstream ss;
+  ss << gameCount << " games in " << std::fixed << std::setprecision(1) << wallSeconds << "s (" << std::setprecision(2) << gamesPerSecond() << " games/s)\n";
+  for (const TournamentEntryResult &entryResult : entryResults) {
+    const auto [low, high] = entryResult.confidenceInterval();
+    ss << "  " << std::left << std::setw(24) << entryResult.name << std::right
+       << std::setw(7) << entryResult.winCount << " wins  "
+       << std::setprecision(2) << std::setw(6) << 100*entryResult.winRate() << "%  "
+       << "95% CI [" << std::setw(6) << 100*low << "%, " << std::setw(6) << 100*high << "%]\n";
+  }
+  return ss.str();
+}
+
+TournamentResult runTournament(const TournamentConfig &config) {
+  if (config.entries.size() < 2 || config.entries.size() > 4) {
+    throw std::runtime_error("A tournament needs 2 to 4 entries");
+  }
+  if (config.threadCount < 1) {
+    throw std::runtime_error("Thread count must be at least 1");
+  }
+  const auto startTime = std::chrono::steady_clock::now();
+  std::ofstream statsOutput;
+  if (!config.statsPath.empty()) {
+    statsOutput.open(config.statsPath, std::ios::trunc);
+    if (!statsOutput) {
+      throw std::runtime_error("Cannot open "+config.statsPath);
+    }
+  }
+  std::mutex statsOutputMutex;
+  std::vector<std::future<size_t>> winners;
+  winners.reserve(config.gameCount);
+  {
+    ThreadPool pool(config.threadCount, config.pinThreads);
+    for (int gameIndex=0; gameIndex<config.gameCount; ++gameIndex) {
+      winners.push_back(pool.submit([&, gameIndex]() {
+        std::string statsLines;
+        const size_t winner = playGame(config, gameIndex, pool, statsOutput.is_open() ? &statsLines : nullptr);
+        if (statsOutput.is_open()) {
+          std::lock_guard guard(statsOutputMutex);
+          statsOutput << statsLines;
+        }
+        return winner;
+      }));
+    }
+    // The pool finishes every game before it's destroyed.
+  }
+  TournamentResult result;
+  for (const TournamentEntry &entry : config.entries) {
+    result.entryResults.push_back(TournamentEntryResult{.name=entry.name, .winCount=0, .gameCount=config.gameCount});
+  }
+  for (auto &winner : winners) {
+    ++result.entryResults[winner.get()].winCount;
+  }
+  result.gameCount = config.gameCount;
+  result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  return result;
+}
+
+std::pair<double, double> wilsonInterval(int successCount, int trialCount, double z) {
+  if (trialCount == 0) {
+    return {0.0, 1.0};
+  }
+  const double n = trialCount;
+  const double p = successCount / n;
+  const double z2 = z*z;
+  const double center = (p + z2/(2*n)) / (1 + z2/n);
+  const double halfWidth = z * std::sqrt(p*(1-p)/n + z2/(4*n*n)) / (1 + z2/n);
+  return {std::max(0.0, center-halfWidth), std::min(1.0, center+halfWidth)};
+}
@@ -0,0 +1,53 @@
+#ifndef TOURNAMENT_HPP_
+#define TOURNAMENT_HPP_
+
+#include "agents.hpp"
+#include "threadPool.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One participant of a tournament. Every game gets fresh agents from `create`, so agents never need to be thread-safe. `create` is passed the pool the games run on; agents which search in parallel should search on it too, rather than starting threads of their own.
+struct TournamentEntry {
+  std::string name;
+  std::function<std::unique_ptr<BaseAgent>(ThreadPool &pool)> create;
+};
+
+struct TournamentConfig {
+  // 2 to 4 entries, all of which play in every game.
+  std::vector<TournamentEntry> entries;
+  int gameCount{1000};
+  int threadCount{1};
+  // Restrict each of the pool's threads to one core.
+  bool pinThreads{false};
+  // If not empty, the SearchStats of every move an agent searched for are written to this file, one JSON object per line: {"game":G,"move":M,"color":"Green","entry":"NAME","stats":{...}}. Lines of a game are written together once it ends.
+  std::string statsPath;
+};
+
+struct TournamentEntryResult {
+  std::string name;
+  int winCount{0};
+  int gameCount{0};
+  double winRate() const;
+  // 95% confidence interval of the win rate.
+  std::pair<double, double> confidenceInterval() const;
+};
+
+struct TournamentResult {
+  std::vector<TournamentEntryResult> entryResults;
+  int gameCount{0};
+  double wallSeconds{0};
+  double gamesPerSecond() const;
+  std::string toString() const;
+};
+
+// Plays `config.gameCount` games on `config.threadCount` threads. Seats and colors rotate from game to game so that no entry keeps the advantage of moving first or of a particular color.
+TournamentResult runTournament(const TournamentConfig &config);
+
+// Wilson score interval of a proportion of `successCount` out of `trialCount`, for the normal quantile `z` (1.96 for 95%).
+std::pair<double, double> wilsonInterval(int successCount, int trialCount, double z = 1.96);
+
+#endif // TOURNAMENT_HPP_
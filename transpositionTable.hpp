@@ -0,0 +1,71 @@
+#ifndef TRANSPOSITION_TABLE_HPP_
+#define TRANSPOSITION_TABLE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A fixed-capacity, thread-safe map from 64-bit position keys to shared values.
+//
+// Keys land in buckets of `kBucketSize` slots. When a bucket is full, the entry with the fewest games played (`Value::gameCount()`) among those which nobody but the table references any more is replaced. Entries which are still referenced elsewhere are never replaced, so every value the table created and which is still alive is one of its `capacity` entries, and the capacity bounds their memory.
+template<typename Value>
+class TranspositionTable {
+public:
+  explicit TranspositionTable(size_t capacity) : buckets_(std::max<size_t>(1, capacity / kBucketSize)) {}
+
+  // Returns the value stored for `key`. If there is none, stores and returns `create()`, or returns nullptr without calling it if every entry of the key's bucket is still referenced elsewhere.
+  template<typename CreateFunction>
+  std::shared_ptr<Value> findOrInsert(uint64_t key, CreateFunction &&create) {
+    Bucket &bucket = buckets_[key % buckets_.size()];
+    std::unique_lock lock(locks_[(key % buckets_.size()) % locks_.size()]);
+    for (Entry &entry : bucket) {
+      if (entry.value != nullptr && entry.key == key) {
+        return entry.value;
+      }
+    }
+    Entry *victim = nullptr;
+    for (Entry &entry : bucket) {
+      if (entry.value == nullptr) {
+        victim = &entry;
+        break;
+      }
+      if (entry.value.use_count() == 1 && (victim == nullptr || entry.value->gameCount() < victim->value->gameCount())) {
+        victim = &entry;
+      }
+    }
+    if (victim == nullptr) {
+      return nullptr;
+    }
+    victim->key = key;
+    victim->value = create();
+    return victim->value;
+  }
+
+  void clear() {
+    for (size_t i=0; i<buckets_.size(); ++i) {
+      std::unique_lock lock(locks_[i % locks_.size()]);
+      for (Entry &entry : buckets_[i]) {
+        entry.value.reset();
+      }
+    }
+  }
+
+  size_t capacity() const {
+    return buckets_.size() * kBucketSize;
+  }
+private:
+  static constexpr size_t kBucketSize = 4;
+  static constexpr size_t kLockCount = 256;
+  struct Entry {
+    uint64_t key{0};
+    std::shared_ptr<Value> value;
+  };
+  using Bucket = std::array<Entry, kBucketSize>;
+  std::vector<Bucket> buckets_;
+  std::array<std::mutex, kLockCount> locks_;
+};
+
+#endif // TRANSPOSITION_TABLE_HPP_
\ No newline at end of file